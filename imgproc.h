@@ -14,6 +14,11 @@
 
 #include "imgproc/utilities.h"
 #include "imgproc/morph.h"
+#include "imgproc/maxtree.h"
+#include "imgproc/bitmorph.h"
+#include "imgproc/morphexpr.h"
+#include "imgproc/tiled.h"
+#include "imgproc/morph3d.h"
 #include "imgproc/kumar.h"
 #include "imgproc/clis.h"
 #include "imgproc/evaluation.h"
@@ -0,0 +1,566 @@
+//
+//  bitmorph.cpp
+//  imgproc
+//
+//  Copyright (c) 2014 CAIB. All rights reserved.
+//
+//  Note: Binary morphology on bit-packed images, 64 pixels are stored in each word
+//  so the operations work on 64 pixels at once with logical and shift operations.
+
+#include "bitmorph.h"
+
+/**
+ Valid bits of the last word of a row
+ @param cols
+ Number of columns of the image
+ @return Mask with the valid bits set
+ */
+uint64 lastBits(const int &cols) {
+    return ( cols % 64 == 0 ) ? ~(uint64)0 : ( ((uint64)1 << (cols % 64)) - 1 );
+}
+
+/**
+ Shift the bits of a row, the bit x of the output takes the bit x+s of the input.
+ The bits coming from outside the row are zero
+ @param src
+ Input row
+ @param dst
+ Output row, must not be the input row
+ @param n
+ Number of words of the row
+ @param s
+ Shift, positive or negative
+ */
+void shiftBits(const uint64 *src, uint64 *dst, const int &n, const int &s) {
+    int ws = ( s >= 0 ) ? s / 64 : -((63 - s) / 64);
+    int bs = s - (ws * 64);
+
+    for (int w = 0; w < n; w++) {
+        int i = w + ws;
+        uint64 lo = ( i >= 0 && i < n ) ? src[i] : 0;
+        uint64 hi = ( i+1 >= 0 && i+1 < n ) ? src[i+1] : 0;
+
+        dst[w] = ( bs == 0 ) ? lo : ( (lo >> bs) | (hi << (64 - bs)) );
+    }
+}
+
+/**
+ Running OR of a row over a window that starts at each pixel, the bit x of the output
+ is the OR of the bits x to x+k-1 of the input (x-k+1 to x when going backwards).
+ The window is built by doubling, so it costs about log(k) shifts
+ @param src
+ Input row
+ @param dst
+ Output row, must not be the input row
+ @param n
+ Number of words of the row
+ @param k
+ Length of the window
+ @param dir
+ 1 to go forwards, -1 to go backwards
+ @param tmp
+ Work buffer of n words
+ */
+void spanBits(const uint64 *src, uint64 *dst, const int &n, const int &k, const int &dir, uint64 *tmp) {
+    std::copy(src, src + n, dst);
+
+    int span = 1;
+    while ( span < k ) {
+        int step = std::min(span, k - span);
+        shiftBits(dst, tmp, n, dir * step);
+        for (int w = 0; w < n; w++)
+            dst[w] |= tmp[w];
+        span += step;
+    }
+}
+
+/**
+ Dilatation of a row by a horizontal segment, the bit x of the output is the OR of the
+ bits x+l to x+r of the input. The part of the segment on each side of the pixel is
+ built apart, so no window is lost at the ends of the row
+ @param src
+ Input row
+ @param dst
+ Output row, must not be the input row
+ @param n
+ Number of words of the row
+ @param l
+ Offset of the first pixel of the segment
+ @param r
+ Offset of the last pixel of the segment
+ @param acc
+ Work buffer of n words
+ @param tmp
+ Work buffer of n words
+ */
+void runBits(const uint64 *src, uint64 *dst, const int &n, const int &l, const int &r, uint64 *acc, uint64 *tmp) {
+    if ( l > 0 ) {
+        spanBits(src, acc, n, r - l + 1, 1, tmp);
+        shiftBits(acc, dst, n, l);
+    } else if ( r < 0 ) {
+        spanBits(src, acc, n, r - l + 1, -1, tmp);
+        shiftBits(acc, dst, n, r);
+    } else {
+        spanBits(src, dst, n, r + 1, 1, tmp);
+        spanBits(src, acc, n, 1 - l, -1, tmp);
+        for (int w = 0; w < n; w++)
+            dst[w] |= acc[w];
+    }
+}
+
+/**
+ Reverse the order of the bits of a word
+ @param v
+ Input word
+ @return Reversed word
+ */
+uint64 reverseBits(uint64 v) {
+    v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+    v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+    v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    v = ((v >> 8) & 0x00FF00FF00FF00FFULL) | ((v & 0x00FF00FF00FF00FFULL) << 8);
+    v = ((v >> 16) & 0x0000FFFF0000FFFFULL) | ((v & 0x0000FFFF0000FFFFULL) << 16);
+    return (v >> 32) | (v << 32);
+}
+
+/**
+ Fill the runs of a mask row that contain a seed. Adding the seeds to the mask makes
+ the carry ripple through the run above each seed, so the carries mark the filled
+ pixels; the runs below the seeds are filled the same way on the reversed row
+ @param m
+ Mask row
+ @param s
+ Seed row, contained in the mask. Holds the filled row at the end
+ @param n
+ Number of words of the row
+ */
+void fillBits(const uint64 *m, uint64 *s, const int &n) {
+    uint64 carryUp = 0, carryDown = 0;
+
+    for (int w = 0; w < n; w++) {
+        uint64 a = m[w], b = s[w];
+        uint64 sum = a + b;
+        uint64 total = sum + carryUp;
+        carryUp = ( sum < a || total < sum ) ? 1 : 0;
+        s[w] = ( ((total ^ a ^ b) & a) | b );
+    }
+
+    for (int w = n-1; w >= 0; w--) {
+        uint64 a = reverseBits(m[w]), b = reverseBits(s[w]);
+        uint64 sum = a + b;
+        uint64 total = sum + carryDown;
+        carryDown = ( sum < a || total < sum ) ? 1 : 0;
+        s[w] |= reverseBits( (total ^ a ^ b) & a );
+    }
+}
+
+/**
+ Number of set bits of a word
+ @param v
+ Input word
+ @return Number of set bits
+ */
+int countBits(uint64 v) {
+    v = v - ((v >> 1) & 0x5555555555555555ULL);
+    v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((v * 0x0101010101010101ULL) >> 56);
+}
+
+//Dilatation of a range of rows of a bit-packed image
+class bitDilateBody : public cv::ParallelLoopBody {
+public:
+    bitDilateBody(const caib::BitMask &_src, caib::BitMask &_dst, const std::vector<cv::Vec3i> &_runs)
+    : src(_src), dst(&_dst), runs(_runs) {}
+
+    void operator()(const cv::Range &range) const {
+        const int n = src.step(), rows = src.size().height;
+        const uint64 last = lastBits(src.size().width);
+        std::vector<uint64> line(n), acc(n), tmp(n);
+
+        for (int y = range.start; y < range.end; y++) {
+            uint64 *out = dst->row(y);
+            std::fill(out, out + n, (uint64)0);
+
+            for (int i = 0; i < runs.size(); i++) {
+                int yy = y + runs[i][2];
+                if ( yy < 0 || yy >= rows )
+                    continue;
+
+                runBits(src.row(yy), &line[0], n, runs[i][0], runs[i][1], &acc[0], &tmp[0]);
+                for (int w = 0; w < n; w++)
+                    out[w] |= line[w];
+            }
+
+            out[n-1] &= last;
+        }
+    }
+
+private:
+    const caib::BitMask &src;
+    caib::BitMask *dst;
+    const std::vector<cv::Vec3i> &runs;
+};
+
+/**
+ Create an empty mask
+ */
+caib::BitMask::BitMask() : stride(0) {}
+
+/**
+ Create a mask with all the pixels set to zero
+ @param size
+ Size of the mask
+ */
+caib::BitMask::BitMask(const cv::Size &size) : stride(0) {
+    create(size);
+}
+
+/**
+ Create a mask from a binary image, every non zero pixel is set
+ @param input
+ Input binary image
+ */
+caib::BitMask::BitMask(const cv::Mat &input) : stride(0) {
+    fromMat(input);
+}
+
+/**
+ Allocate the mask with all the pixels set to zero
+ @param size
+ Size of the mask
+ */
+void caib::BitMask::create(const cv::Size &size) {
+    sz = size;
+    stride = (size.width + 63) / 64;
+    words.assign(stride * size.height, 0);
+}
+
+/**
+ Pack a binary image, every non zero pixel is set
+ @param input
+ Input binary image
+ */
+void caib::BitMask::fromMat(const cv::Mat &input) {
+    CV_Assert( caib::isGray(input) );
+
+    create(input.size());
+
+    for (int y = 0; y < sz.height; y++) {
+        const uchar *in = input.ptr(y);
+        uint64 *out = row(y);
+
+        for (int w = 0; w < stride; w++) {
+            const int x0 = w * 64, x1 = std::min(sz.width, x0 + 64);
+            uint64 v = 0;
+
+            for (int x = x0; x < x1; x++)
+                v |= (uint64)( in[x] != 0 ) << (x - x0);
+
+            out[w] = v;
+        }
+    }
+}
+
+/**
+ Unpack the mask to a binary image
+ @return Output binary image, 255 in the set pixels and 0 elsewhere
+ */
+cv::Mat caib::BitMask::toMat() const {
+    cv::Mat output;
+    toMat(output);
+
+    return output;
+}
+
+/**
+ Unpack the mask to a binary image, the output is reallocated only if its size or type differ
+ @param output
+ Output binary image, 255 in the set pixels and 0 elsewhere
+ */
+void caib::BitMask::toMat(cv::Mat &output) const {
+    output.create(sz, cv::DataType<uchar>::type);
+
+    for (int y = 0; y < sz.height; y++) {
+        const uint64 *in = row(y);
+        uchar *out = output.ptr(y);
+
+        for (int w = 0; w < stride; w++) {
+            const int x0 = w * 64, len = std::min(sz.width - x0, 64);
+            const uint64 v = in[w];
+
+            for (int i = 0; i < len; i++)
+                out[x0 + i] = (uchar)( 0 - (uchar)((v >> i) & 1) );
+        }
+    }
+}
+
+/**
+ Intersection of two masks
+ @param other
+ Mask of the same size
+ @return Output mask
+ */
+caib::BitMask caib::BitMask::operator&(const BitMask &other) const {
+    CV_Assert( sz == other.sz );
+
+    BitMask output(*this);
+    for (int i = 0; i < words.size(); i++)
+        output.words[i] &= other.words[i];
+
+    return output;
+}
+
+/**
+ Union of two masks
+ @param other
+ Mask of the same size
+ @return Output mask
+ */
+caib::BitMask caib::BitMask::operator|(const BitMask &other) const {
+    CV_Assert( sz == other.sz );
+
+    BitMask output(*this);
+    for (int i = 0; i < words.size(); i++)
+        output.words[i] |= other.words[i];
+
+    return output;
+}
+
+/**
+ Symetrical difference of two masks
+ @param other
+ Mask of the same size
+ @return Output mask
+ */
+caib::BitMask caib::BitMask::operator^(const BitMask &other) const {
+    CV_Assert( sz == other.sz );
+
+    BitMask output(*this);
+    for (int i = 0; i < words.size(); i++)
+        output.words[i] ^= other.words[i];
+
+    return output;
+}
+
+/**
+ Negative of a mask
+ @return Output mask
+ */
+caib::BitMask caib::BitMask::operator~() const {
+    BitMask output(*this);
+    const uint64 last = lastBits(sz.width);
+
+    for (int i = 0; i < words.size(); i++)
+        output.words[i] = ~words[i];
+    for (int y = 0; y < sz.height; y++)
+        output.row(y)[stride-1] &= last;
+
+    return output;
+}
+
+/**
+ Check if two masks are equal
+ @param other
+ Mask to compare
+ @return TRUE if the masks have the same size and pixels, FALSE if not
+ */
+bool caib::BitMask::operator==(const BitMask &other) const {
+    return sz == other.sz && words == other.words;
+}
+
+/**
+ Dilatation of the mask, the pixels outside the mask are taken as zero
+ @param se
+ Structurant element
+ @return Output mask
+ */
+caib::BitMask caib::BitMask::dilate(const cv::Mat &se) const {
+    std::vector<cv::Vec3i> runs = caib::morphSeruns(se);
+    BitMask output(sz);
+
+    if ( !empty() )
+        cv::parallel_for_(cv::Range(0, sz.height), bitDilateBody(*this, output, runs));
+
+    return output;
+}
+
+/**
+ Erosion of the mask, computed as the negative of the dilatation of the negative. The
+ pixels outside the mask are taken as set, as cv::erode does
+ @param se
+ Structurant element
+ @return Output mask
+ */
+caib::BitMask caib::BitMask::erode(const cv::Mat &se) const {
+    return ~( (~(*this)).dilate(se) );
+}
+
+/**
+ Grow a row of the reconstruction inside its mask row through the horizontal links of
+ the structurant element, the runs holding a seed are filled at once when the horizontal
+ neighbours are connected
+ @param m
+ Mask row
+ @param seed
+ Row being grown, contained in the mask
+ @param n
+ Number of words of the row
+ @param rowfill
+ Fill the whole runs of the mask holding a seed
+ @param inrow
+ Runs of the structurant element on the row left after the fill
+ @param line
+ Work buffer of n words
+ @param acc
+ Work buffer of n words
+ @param tmp
+ Work buffer of n words
+ */
+void growRow(const uint64 *m, uint64 *seed, const int &n, const bool &rowfill, const std::vector<cv::Vec3i> &inrow, uint64 *line, uint64 *acc, uint64 *tmp) {
+    bool grow = true;
+    
+    while ( grow ) {
+        grow = false;
+
+        if ( rowfill )
+            fillBits(m, seed, n);
+
+        for (int j = 0; j < inrow.size(); j++) {
+            runBits(seed, line, n, inrow[j][0], inrow[j][1], acc, tmp);
+            for (int w = 0; w < n; w++) {
+                uint64 v = seed[w] | (line[w] & m[w]);
+                if ( v != seed[w] ) {
+                    seed[w] = v;
+                    grow = true;
+                }
+            }
+        }
+    }
+}
+
+/**
+ Inferior reconstruction of this mask used as marker. The rows are grown inside their
+ mask row, and each row that changes is pushed on a stack to bring its new pixels to the
+ rows it reaches through the structurant element. The last row changed is taken first, so
+ a change runs up or down the image at once and the rows are only visited again where the
+ reconstruction still grows
+ @param mask
+ Mask of the reconstruction
+ @param se
+ Structurant element
+ @return Output mask
+ */
+caib::BitMask caib::BitMask::reconstruct(const BitMask &mask, const cv::Mat &se) const {
+    CV_Assert( sz == mask.sz );
+
+    BitMask output = (*this) & mask;
+    if ( empty() )
+        return output;
+
+    std::vector<cv::Vec3i> runs = caib::morphSeruns(se), links, inrow;
+    for (int i = 0; i < runs.size(); i++) {
+        if ( runs[i][2] != 0 )
+            links.push_back(runs[i]);
+        else if ( runs[i][0] != 0 || runs[i][1] != 0 )
+            inrow.push_back(runs[i]);
+    }
+
+    //horizontal neighbours connect whole runs of the mask, then the in-row
+    //offsets within one pixel add nothing to the filled runs
+    bool rowfill = false;
+    for (int i = 0; i < inrow.size(); i++)
+        for (int j = 0; j < inrow.size(); j++)
+            if ( inrow[i][0] <= -1 && inrow[i][1] >= -1 && inrow[j][0] <= 1 && inrow[j][1] >= 1 )
+                rowfill = true;
+
+    for (int i = (int) inrow.size() - 1; i >= 0 && rowfill; i--)
+        if ( inrow[i][0] >= -1 && inrow[i][1] <= 1 )
+            inrow.erase(inrow.begin() + i);
+
+    const int n = stride, rows = sz.height;
+    std::vector<uint64> seed(n), line(n), acc(n), tmp(n);
+    std::vector<int> stack;
+    std::vector<uchar> dirty(rows, 0);
+
+    for (int y = rows-1; y >= 0; y--) {
+        uint64 *out = output.row(y);
+        if ( std::count(out, out + n, (uint64)0) == n )
+            continue;
+
+        growRow(mask.row(y), out, n, rowfill, inrow, &line[0], &acc[0], &tmp[0]);
+        stack.push_back(y);
+        dirty[y] = 1;
+    }
+
+    while ( !stack.empty() ) {
+        int src = stack.back();
+        stack.pop_back();
+        if ( !dirty[src] )
+            continue;
+        dirty[src] = 0;
+
+        //the row y takes the pixels of the row y + dy
+        for (int i = 0; i < links.size(); i++) {
+            int y = src - links[i][2];
+            if ( y < 0 || y >= rows )
+                continue;
+
+            uint64 *out = output.row(y);
+            const uint64 *m = mask.row(y);
+
+            runBits(output.row(src), &line[0], n, links[i][0], links[i][1], &acc[0], &tmp[0]);
+
+            bool changed = false;
+            for (int w = 0; w < n; w++) {
+                seed[w] = out[w] | (line[w] & m[w]);
+                changed = changed || seed[w] != out[w];
+            }
+            if ( !changed )
+                continue;
+
+            growRow(m, &seed[0], n, rowfill, inrow, &line[0], &acc[0], &tmp[0]);
+            std::copy(seed.begin(), seed.end(), out);
+
+            stack.push_back(y);
+            dirty[y] = 1;
+        }
+    }
+
+    return output;
+}
+
+/**
+ Set the pixels on the border of the mask
+ */
+void caib::BitMask::setFrame() {
+    if ( empty() )
+        return;
+
+    const uint64 last = lastBits(sz.width);
+
+    for (int y = 0; y < sz.height; y++) {
+        uint64 *r = row(y);
+
+        if ( y == 0 || y == sz.height-1 ) {
+            std::fill(r, r + stride, ~(uint64)0);
+            r[stride-1] &= last;
+        } else {
+            r[0] |= 1;
+            r[(sz.width-1) / 64] |= (uint64)1 << ((sz.width-1) % 64);
+        }
+    }
+}
+
+/**
+ Number of set pixels
+ @return Number of set pixels
+ */
+int caib::BitMask::count() const {
+    int n = 0;
+
+    for (int i = 0; i < words.size(); i++)
+        n += countBits(words[i]);
+
+    return n;
+}
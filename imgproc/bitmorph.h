@@ -0,0 +1,66 @@
+//
+//  bitmorph.h
+//  imgproc
+//
+//  Copyright (c) 2014 CAIB. All rights reserved.
+//
+//  Note: Binary morphology on bit-packed images, 64 pixels are stored in each word
+//  so the operations work on 64 pixels at once with logical and shift operations.
+
+#ifndef __imgproc__bitmorph__
+#define __imgproc__bitmorph__
+
+#include <opencv/cv.h>
+#include <opencv/highgui.h>
+
+#include "utilities.h"
+#include "morph.h"
+
+#include <vector>
+
+namespace caib {
+
+    //Binary image packed in 64 pixels per word, each row starts at a new word and
+    //the bits after the last column of a row are always zero
+    class CAIB_EXPORTS BitMask {
+    public:
+        BitMask();
+        BitMask(const cv::Size &size);
+        BitMask(const cv::Mat &input);
+
+        //Convertions
+        void create(const cv::Size &size);
+        void fromMat(const cv::Mat &input);
+        cv::Mat toMat() const;
+        void toMat(cv::Mat &output) const;
+
+        //Logical operations
+        BitMask operator&(const BitMask &other) const;
+        BitMask operator|(const BitMask &other) const;
+        BitMask operator^(const BitMask &other) const;
+        BitMask operator~() const;
+        bool operator==(const BitMask &other) const;
+
+        //Morphology
+        BitMask erode(const cv::Mat &se = morphSedefault()) const;
+        BitMask dilate(const cv::Mat &se = morphSedefault()) const;
+        BitMask reconstruct(const BitMask &mask, const cv::Mat &se = morphSedefault()) const;
+
+        void setFrame();
+        int count() const;
+
+        bool empty() const { return words.empty(); }
+        cv::Size size() const { return sz; }
+        int step() const { return stride; }
+        uint64 *row(const int &y) { return &words[y * stride]; }
+        const uint64 *row(const int &y) const { return &words[y * stride]; }
+
+    private:
+        cv::Size sz;
+        int stride;                 //words per row
+        std::vector<uint64> words;
+    };
+
+};
+
+#endif /* defined(__imgproc__bitmorph__) */
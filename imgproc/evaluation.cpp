@@ -21,7 +21,20 @@
  @return Area overlap coefficient
  */
 double caib::areaOverlap(const cv::Mat &inputGST, const cv::Mat &inputS) {
-    CV_Assert ( caib::isBinary(inputGST) && caib::isBinary(inputS) && inputGST.cols == inputS.cols && inputGST.rows == inputS.rows);
+    return caib::areaOverlap(caib::BinaryMat(inputGST), caib::BinaryMat(inputS));
+}
+
+/**
+ Calculate the area overlap coefficient for a gold standar 
+ binary input image and a segmentation binary input image, both already checked
+ @param inputGST
+ Gold standard binary image
+ @param inputS
+ Segmented binary image
+ @return Area overlap coefficient
+ */
+double caib::areaOverlap(const caib::BinaryMat &inputGST, const caib::BinaryMat &inputS) {
+    CV_Assert ( inputGST.size() == inputS.size() );
     
     cv::Mat img_intersec = caib::morphIntersec(inputGST, inputS);
     cv::Mat img_union = caib::morphUnion(inputGST, inputS);
@@ -42,13 +55,26 @@ double caib::areaOverlap(const cv::Mat &inputGST, const cv::Mat &inputS) {
  @return Area similarity coefficient
  */
 double caib::areaSimilarity(const cv::Mat &inputGST, const cv::Mat &inputS) {
-    CV_Assert ( caib::isBinary(inputGST) && caib::isBinary(inputS) && inputGST.cols == inputS.cols && inputGST.rows == inputS.rows);
+    return caib::areaSimilarity(caib::BinaryMat(inputGST), caib::BinaryMat(inputS));
+}
+
+/**
+ Calculate the area similarity coefficient for a gold standar
+ binary input image and a segmentation binary input image, both already checked
+ @param inputGST
+ Gold standard binary image
+ @param inputS
+ Segmented binary image
+ @return Area similarity coefficient
+ */
+double caib::areaSimilarity(const caib::BinaryMat &inputGST, const caib::BinaryMat &inputS) {
+    CV_Assert ( inputGST.size() == inputS.size() );
     
     cv::Mat img_intersec = caib::morphIntersec(inputGST, inputS);
     
     int count_intersec = cv::countNonZero(img_intersec);;
-    int count_inputGST = cv::countNonZero(inputGST);
-    int count_inputS = cv::countNonZero(inputS);
+    int count_inputGST = cv::countNonZero(inputGST.mat());
+    int count_inputS = cv::countNonZero(inputS.mat());
     
     return ( 2.00 * (double)count_intersec )/( (double)count_inputGST + (double)count_inputS );
 }
@@ -63,14 +89,27 @@ double caib::areaSimilarity(const cv::Mat &inputGST, const cv::Mat &inputS) {
  @return Area overlap error coefficient
  */
 double caib::overlapError(const cv::Mat &inputGST, const cv::Mat &inputS) {
-    CV_Assert ( caib::isBinary(inputGST) && caib::isBinary(inputS) && inputGST.cols == inputS.cols && inputGST.rows == inputS.rows);
+    return caib::overlapError(caib::BinaryMat(inputGST), caib::BinaryMat(inputS));
+}
+
+/**
+ Calculate the area overlap error coefficient for a gold standar
+ binary input image and a segmentation binary input image, both already checked
+ @param inputGST
+ Gold standard binary image
+ @param inputS
+ Segmented binary image
+ @return Area overlap error coefficient
+ */
+double caib::overlapError(const caib::BinaryMat &inputGST, const caib::BinaryMat &inputS) {
+    CV_Assert ( inputGST.size() == inputS.size() );
     
     cv::Mat img_intersec = caib::morphIntersec(inputS, inputGST);
     cv::Mat img_union = caib::morphUnion(inputS, inputGST);
     
     int count_intersec = cv::countNonZero(img_intersec);
     int count_union = cv::countNonZero(img_union);
-    int count_inputGST = cv::countNonZero(inputGST);
+    int count_inputGST = cv::countNonZero(inputGST.mat());
     
     return (double)(count_union-count_intersec)/(double)count_inputGST;
 }
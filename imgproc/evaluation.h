@@ -24,6 +24,9 @@ namespace caib {
     CAIB_EXPORTS double areaOverlap(const cv::Mat &inputGST, const cv::Mat &inputS);
     CAIB_EXPORTS double areaSimilarity(const cv::Mat &inputGST, const cv::Mat &inputS);
     CAIB_EXPORTS double overlapError(const cv::Mat &inputGST, const cv::Mat &inputS);
+    CAIB_EXPORTS double areaOverlap(const BinaryMat &inputGST, const BinaryMat &inputS);
+    CAIB_EXPORTS double areaSimilarity(const BinaryMat &inputGST, const BinaryMat &inputS);
+    CAIB_EXPORTS double overlapError(const BinaryMat &inputGST, const BinaryMat &inputS);
     CAIB_EXPORTS double sensivity(const cv::Mat &inputGST, const cv::Mat &inputS);
     CAIB_EXPORTS int getFP(const cv::Mat &inputGST, const cv::Mat &inputS);
     CAIB_EXPORTS int getTP(const cv::Mat &inputGST, const cv::Mat &inputS);
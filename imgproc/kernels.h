@@ -0,0 +1,210 @@
+//
+//  kernels.h
+//  imgproc
+//
+//  Copyright (c) 2014 CAIB. All rights reserved.
+//
+//  Note: Pixel kernels shared by the morphological operations, they work on single
+//  lines of pixels so they can be used on whole images or on streamed rows. The
+//  kernels are templates on the pixel type (uchar, ushort or float), each depth gets
+//  its own compiled version. The helpers handling the output images given by the
+//  callers are also kept here.
+
+#ifndef __imgproc__kernels__
+#define __imgproc__kernels__
+
+#include <opencv/cv.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+/**
+ Check if two images share their data, an output written in place over an input
+ would overwrite pixels still to be read
+ @param input1
+ First image
+ @param input2
+ Second image
+ @return TRUE if the images share their data
+ */
+inline bool sharesData(const cv::Mat &input1, const cv::Mat &input2) {
+    return !input1.empty() && !input2.empty() && input1.datastart == input2.datastart;
+}
+
+/**
+ Header where a result can be written directly. The output is used unless it shares
+ its data with an input still to be read, or it is not continuous and the algorithm
+ works on the whole buffer, in both cases a new image is allocated
+ @param output
+ Output image given by the caller
+ @param input
+ Input image read by the algorithm
+ @param continuous
+ The algorithm needs a continuous image
+ @return Header of the result
+ */
+inline cv::Mat resultHeader(const cv::Mat &output, const cv::Mat &input, const bool &continuous) {
+    if ( sharesData(output, input) || (continuous && !output.empty() && !output.isContinuous()) )
+        return cv::Mat();
+
+    return output;
+}
+
+/**
+ Store a result into the output image. When the result was not written directly in
+ the output but the output has the right size and type, its data is reused
+ @param result
+ Result image
+ @param output
+ Output image given by the caller
+ */
+inline void storeResult(const cv::Mat &result, cv::Mat &output) {
+    if ( result.data == output.data )
+        return;
+
+    if ( output.size() == result.size() && output.type() == result.type() )
+        result.copyTo(output);
+    else
+        output = result;
+}
+
+//Minimum side of a box structurant element handled by the van Herk/Gil-Werman algorithm
+const int VHGW_MINSIZE = 7;
+
+/**
+ Lowest value of a pixel type, the identity of the dilatation
+ @return Lowest value
+ */
+template <class T>
+inline T pixelLowest() {
+    return std::numeric_limits<T>::is_integer ? std::numeric_limits<T>::min() : -std::numeric_limits<T>::max();
+}
+
+/**
+ Highest value of a pixel type, the identity of the erosion
+ @return Highest value
+ */
+template <class T>
+inline T pixelHighest() {
+    return std::numeric_limits<T>::max();
+}
+
+/**
+ Negative of a pixel, the complement to the highest value for the integer types
+ @param v
+ Pixel value
+ @return Negative value
+ */
+template <class T>
+inline T pixelNeg(const T &v) {
+    return pixelHighest<T>() - v;
+}
+
+template <>
+inline float pixelNeg(const float &v) {
+    return -v;
+}
+
+//Ordering of the dilatation, also used by the inferior reconstruction
+template <class T>
+struct dilOrder {
+    typedef T value_type;
+    static T identity() { return pixelLowest<T>(); }
+    static T extend(const T &a, const T &b) { return std::max(a, b); }
+    static void extend(const cv::Mat &a, const cv::Mat &b, cv::Mat &dst) { cv::max(a, b, dst); }
+    static void apply(const cv::Mat &src, cv::Mat &dst, const cv::Mat &se) { cv::dilate(src, dst, se); }
+    static T clip(const T &a, const T &b) { return std::min(a, b); }
+    static bool below(const T &a, const T &b) { return a < b; }
+};
+
+//Ordering of the erosion, also used by the superior reconstruction
+template <class T>
+struct eroOrder {
+    typedef T value_type;
+    static T identity() { return pixelHighest<T>(); }
+    static T extend(const T &a, const T &b) { return std::min(a, b); }
+    static void extend(const cv::Mat &a, const cv::Mat &b, cv::Mat &dst) { cv::min(a, b, dst); }
+    static void apply(const cv::Mat &src, cv::Mat &dst, const cv::Mat &se) { cv::erode(src, dst, se); }
+    static T clip(const T &a, const T &b) { return std::max(a, b); }
+    static bool below(const T &a, const T &b) { return a > b; }
+};
+
+/**
+ Running erosion (or dilatation) of a line of pixels over a window, computed with the
+ van Herk/Gil-Werman algorithm in about three comparisons per pixel. Pixels outside
+ the line are ignored
+ @param src
+ Source line
+ @param dst
+ Destination line
+ @param n
+ Number of pixels of the line
+ @param k
+ Size of the window
+ @param anchor
+ Position of the anchor inside the window
+ @param g
+ Buffer for the forward partial results (n+k-1 elements)
+ @param h
+ Buffer for the backward partial results (n+k-1 elements)
+ */
+template <class Order>
+void vhgwLine(const typename Order::value_type *src, typename Order::value_type *dst, const int &n, const int &k,
+              const int &anchor, typename Order::value_type *g, typename Order::value_type *h) {
+    typedef typename Order::value_type T;
+    const int len = n + k - 1;
+
+    for (int j = 0; j < len; j++) {
+        int i = j - anchor;
+        T value = ( i >= 0 && i < n ) ? src[i] : Order::identity();
+        g[j] = ( j % k == 0 ) ? value : Order::extend(g[j-1], value);
+    }
+
+    for (int j = len-1; j >= 0; j--) {
+        int i = j - anchor;
+        T value = ( i >= 0 && i < n ) ? src[i] : Order::identity();
+        h[j] = ( j % k == k-1 || j == len-1 ) ? value : Order::extend(h[j+1], value);
+    }
+
+    for (int i = 0; i < n; i++)
+        dst[i] = Order::extend(h[i], g[i+k-1]);
+}
+
+/**
+ Find the root of an element of a union-find forest, halving the path on the way
+ @param parent
+ Parent of each element
+ @param p
+ Element
+ @return Root of the element
+ */
+inline int findRoot(std::vector<int> &parent, int p) {
+    while ( parent[p] != p ) {
+        parent[p] = parent[parent[p]];
+        p = parent[p];
+    }
+
+    return p;
+}
+
+/**
+ Join the trees of two elements of a union-find forest, the smallest root is kept
+ @param parent
+ Parent of each element
+ @param p
+ Element
+ @param q
+ Element
+ */
+inline void unionRoots(std::vector<int> &parent, int p, int q) {
+    p = findRoot(parent, p);
+    q = findRoot(parent, q);
+
+    if ( p < q )
+        parent[q] = p;
+    else
+        parent[p] = q;
+}
+
+#endif /* defined(__imgproc__kernels__) */
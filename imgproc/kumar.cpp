@@ -308,8 +308,28 @@ void selectConcavities(const cv::Mat &inputImg, std::vector<std::vector<cv::Poin
  @return Splitted binary image
  */
 cv::Mat caib::kumar(const cv::Mat &inputImg, const double &cd, const double &sa, const double &cc, const double &cl, const double &cr, const double &ca) {
-    
-    CV_Assert (caib::isBinary(inputImg));
+    return caib::kumar(caib::BinaryMat(inputImg), cd, sa, cc, cl, cr, ca);
+}
+
+/**
+ Perform the Kumar clump splitting algorithm on a binary image already checked
+ @param inputImg
+ Input binary image
+ @param cd
+ Concavity depth threshold
+ @param sa
+ Saliency threshold
+ @param cc
+ Concacivity-Concavity angle threshold
+ @param cl
+ Concavity-Line angle threshold
+ @param cr
+ Concavity rate threshold
+ @param ca
+ Concavity angle threshold
+ @return Splitted binary image
+ */
+cv::Mat caib::kumar(const caib::BinaryMat &inputImg, const double &cd, const double &sa, const double &cc, const double &cl, const double &cr, const double &ca) {
     
     k_cdThresh = cd;
     k_saThresh = sa;
@@ -319,7 +339,7 @@ cv::Mat caib::kumar(const cv::Mat &inputImg, const double &cd, const double &sa,
     k_crThresh = cr;
     
 
-    cv::Mat outputImg = inputImg.clone();
+    cv::Mat outputImg = inputImg.mat().clone();
     
     std::vector< std::vector< cv::Point > > contours;
     std::vector< kLine > lines;
@@ -330,7 +350,7 @@ cv::Mat caib::kumar(const cv::Mat &inputImg, const double &cd, const double &sa,
     
 	while ( true ) {
         lines = std::vector< kLine >();
-        selectConcavities( outputImg.clone(), contours, hierarchy, defects, CRs, CAs );
+        selectConcavities( outputImg, contours, hierarchy, defects, CRs, CAs );
         bool foundlines = selectSplitLines(contours, defects, lines);
         if(!foundlines){
             
@@ -36,6 +36,7 @@ namespace caib {
 
     //perform Kumar algorithm for clump splitting
     CAIB_EXPORTS cv::Mat kumar(const cv::Mat &inputImg, const double &cd = STD_CDTHRESH, const double &sa = STD_SATHRESH, const double &cc = STD_CCTHRESH, const double &cl = STD_CLTHRESH, const double &cr = STD_CRTHRESH, const double &ca = STD_CATHRESH);
+    CAIB_EXPORTS cv::Mat kumar(const BinaryMat &inputImg, const double &cd = STD_CDTHRESH, const double &sa = STD_SATHRESH, const double &cc = STD_CCTHRESH, const double &cl = STD_CLTHRESH, const double &cr = STD_CRTHRESH, const double &ca = STD_CATHRESH);
 
 };
 
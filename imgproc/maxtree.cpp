@@ -0,0 +1,324 @@
+//
+//  maxtree.cpp
+//  imgproc
+//
+//  Copyright (c) 2014 CAIB. All rights reserved.
+//
+//  Note: The tree is built following the union-find algorithm described in
+//  C. Berger, T. Geraud, R. Levillain, N. Widynski, A. Baillard, E. Bertin,
+//  "Effective Component Tree Computation with Application to Pattern Recognition in Astronomical Imaging",
+//  IEEE International Conference on Image Processing (2007) 41-44
+
+#include "maxtree.h"
+
+#include <limits>
+
+/**
+ Find the root of a pixel in the union-find forest used while building the tree
+ @param zpar
+ Parent of each pixel in the forest
+ @param p
+ Pixel
+ @return Root of the pixel
+ */
+int findTreeRoot(std::vector<int> &zpar, int p) {
+    int r = p;
+
+    while ( zpar[r] != r )
+        r = zpar[r];
+
+    while ( zpar[p] != r ) {
+        int q = zpar[p];
+        zpar[p] = r;
+        p = q;
+    }
+
+    return r;
+}
+
+//Order of the pixels from the root level to the leaves level, by index inside a level
+template <class T>
+struct levelLess {
+    levelLess(const T *_values, bool _mintree) : values(_values), mintree(_mintree) {}
+
+    bool operator()(const int &p, const int &q) const {
+        return mintree ? values[p] > values[q] : values[p] < values[q];
+    }
+
+    const T *values;
+    bool mintree;
+};
+
+/**
+ Sort the pixels from the root level to the leaves level by comparison, keeping the
+ index order inside a level
+ @param values
+ Continuous grayscale image
+ @param mintree
+ The root is the highest level instead of the lowest
+ @param sorted
+ Pixels sorted
+ */
+template <class T>
+void compareLevels(const cv::Mat &values, const bool &mintree, std::vector<int> &sorted) {
+    sorted.resize(values.total());
+    for (int p = 0; p < sorted.size(); p++)
+        sorted[p] = p;
+
+    std::stable_sort(sorted.begin(), sorted.end(), levelLess<T>(values.ptr<T>(), mintree));
+}
+
+/**
+ Sort the pixels of an integer image from the root level to the leaves level by
+ counting, keeping the index order inside a level
+ @param values
+ Continuous grayscale image
+ @param mintree
+ The root is the highest level instead of the lowest
+ @param sorted
+ Pixels sorted
+ */
+template <class T>
+void countLevels(const cv::Mat &values, const bool &mintree, std::vector<int> &sorted) {
+    const int sz = (int) values.total();
+    const T *v = values.ptr<T>();
+
+    sorted.resize(sz);
+
+    const int top = (int) std::numeric_limits<T>::max();
+    std::vector<int> hist(top + 2, 0);
+    for (int p = 0; p < sz; p++)
+        hist[ (mintree ? top - (int) v[p] : (int) v[p]) + 1 ]++;
+    for (int l = 1; l < top + 2; l++)
+        hist[l] += hist[l-1];
+
+    for (int p = 0; p < sz; p++)
+        sorted[ hist[ mintree ? top - (int) v[p] : (int) v[p] ]++ ] = p;
+}
+
+/**
+ Canonize the tree so every pixel points to the canonical pixel of its node
+ @param values
+ Continuous grayscale image
+ @param sorted
+ Pixels sorted from the root to the leaves
+ @param parent
+ Parent of each pixel
+ */
+template <class T>
+void canonizeTree(const cv::Mat &values, const std::vector<int> &sorted, std::vector<int> &parent) {
+    const T *v = values.ptr<T>();
+
+    for (int i = 0; i < sorted.size(); i++) {
+        int p = sorted[i];
+        int q = parent[p];
+        if ( v[ parent[q] ] == v[q] )
+            parent[p] = parent[q];
+    }
+}
+
+/**
+ Count the nodes of a canonized tree
+ @param values
+ Continuous grayscale image
+ @param sorted
+ Pixels sorted from the root to the leaves
+ @param parent
+ Parent of each pixel
+ @return Number of nodes
+ */
+template <class T>
+int countNodes(const cv::Mat &values, const std::vector<int> &sorted, const std::vector<int> &parent) {
+    const T *v = values.ptr<T>();
+    int n = 0;
+
+    for (int i = 0; i < sorted.size(); i++) {
+        int p = sorted[i];
+        if ( parent[p] == p || v[ parent[p] ] != v[p] )
+            n++;
+    }
+
+    return n;
+}
+
+/**
+ Remove the nodes of a canonized tree with an area smaller than a threshold
+ @param values
+ Continuous grayscale image
+ @param sorted
+ Pixels sorted from the root to the leaves
+ @param parent
+ Parent of each pixel
+ @param area
+ Area of the node of each canonical pixel
+ @param a
+ Minimum admited area of the nodes
+ @param output
+ Output grayscale image, of the size and type of the values
+ */
+template <class T>
+void filterArea(const cv::Mat &values, const std::vector<int> &sorted, const std::vector<int> &parent,
+                const std::vector<int> &area, const double &a, cv::Mat &output) {
+    const T *v = values.ptr<T>();
+    T *out = output.ptr<T>();
+
+    for (int i = 0; i < sorted.size(); i++) {
+        int p = sorted[i];
+        int q = parent[p];
+
+        if ( q == p )
+            out[p] = v[p];
+        else if ( v[q] == v[p] )
+            out[p] = out[q];
+        else
+            out[p] = ( area[p] >= a ) ? v[p] : out[q];
+    }
+}
+
+/**
+ Create an empty tree
+ */
+caib::MaxTree::MaxTree() : mintree(false) {}
+
+/**
+ Create the component tree of a grayscale image
+ @param input
+ Input grayscale image
+ @param mintree
+ Build the min-tree instead of the max-tree
+ @param se
+ Structurant element defining the connectivity
+ */
+caib::MaxTree::MaxTree(const cv::Mat &input, const bool &mintree, const cv::Mat &se) : mintree(false) {
+    build(input, mintree, se);
+}
+
+/**
+ Build the component tree of a grayscale image
+ @param input
+ Input grayscale image, a float image must not hold NaN or infinite values, which have no
+ place in the order of the levels
+ @param mintree
+ Build the min-tree instead of the max-tree
+ @param se
+ Structurant element defining the connectivity
+ */
+void caib::MaxTree::build(const cv::Mat &input, const bool &mintree, const cv::Mat &se) {
+    CV_Assert( caib::isIntensity(input) && (input.depth() != CV_32F || cv::checkRange(input)) );
+
+    this->size = input.size();
+    this->mintree = mintree;
+
+    const int cols = input.cols, rows = input.rows, sz = cols * rows;
+
+    values = input.clone();
+
+    //symmetric neighbourhood
+    std::vector<cv::Point> offsets = caib::morphSeoffsets(se);
+    for (int i = (int) offsets.size() - 1; i >= 0; i--) {
+        cv::Point o(-offsets[i].x, -offsets[i].y);
+        if ( std::find(offsets.begin(), offsets.end(), o) == offsets.end() )
+            offsets.push_back(o);
+    }
+
+    //from the root level to the leaves level
+    switch ( values.depth() ) {
+        case CV_8U:
+            countLevels<uchar>(values, mintree, sorted);
+            break;
+        case CV_16U:
+            countLevels<ushort>(values, mintree, sorted);
+            break;
+        default:
+            compareLevels<float>(values, mintree, sorted);
+            break;
+    }
+
+    //union-find from the leaves to the root
+    parent.assign(sz, -1);
+    std::vector<int> zpar(sz, -1);
+
+    for (int i = sz-1; i >= 0; i--) {
+        int p = sorted[i];
+        int x = p % cols, y = p / cols;
+
+        parent[p] = p;
+        zpar[p] = p;
+
+        for (int k = 0; k < offsets.size(); k++) {
+            int nx = x + offsets[k].x, ny = y + offsets[k].y;
+            if ( nx < 0 || nx >= cols || ny < 0 || ny >= rows )
+                continue;
+
+            int n = nx + (ny * cols);
+            if ( zpar[n] == -1 )
+                continue;
+
+            int r = findTreeRoot(zpar, n);
+            if ( r != p ) {
+                parent[r] = p;
+                zpar[r] = p;
+            }
+        }
+    }
+
+    //canonize the tree so every pixel points to the canonical pixel of its node
+    switch ( values.depth() ) {
+        case CV_8U:
+            canonizeTree<uchar>(values, sorted, parent);
+            break;
+        case CV_16U:
+            canonizeTree<ushort>(values, sorted, parent);
+            break;
+        default:
+            canonizeTree<float>(values, sorted, parent);
+            break;
+    }
+
+    area.assign(sz, 1);
+    for (int i = sz-1; i > 0; i--)
+        area[ parent[ sorted[i] ] ] += area[ sorted[i] ];
+}
+
+/**
+ Number of nodes of the tree
+ @return Number of nodes
+ */
+int caib::MaxTree::nodes() const {
+    switch ( values.depth() ) {
+        case CV_8U:
+            return countNodes<uchar>(values, sorted, parent);
+        case CV_16U:
+            return countNodes<ushort>(values, sorted, parent);
+        default:
+            return countNodes<float>(values, sorted, parent);
+    }
+}
+
+/**
+ Remove the nodes with an area smaller than a threshold, each removed node takes
+ the gray level of its closest kept ancestor. On a max-tree this is the area opening,
+ on a min-tree the area closing
+ @param a
+ Minimum admited area of the nodes
+ @return Output grayscale image
+ */
+cv::Mat caib::MaxTree::areaFilter(const double &a) const {
+    CV_Assert( !empty() );
+
+    cv::Mat output = cv::Mat(size, values.type());
+
+    switch ( values.depth() ) {
+        case CV_8U:
+            filterArea<uchar>(values, sorted, parent, area, a, output);
+            break;
+        case CV_16U:
+            filterArea<ushort>(values, sorted, parent, area, a, output);
+            break;
+        default:
+            filterArea<float>(values, sorted, parent, area, a, output);
+            break;
+    }
+
+    return output;
+}
@@ -0,0 +1,49 @@
+//
+//  maxtree.h
+//  imgproc
+//
+//  Copyright (c) 2014 CAIB. All rights reserved.
+//
+//  Note: The tree is built following the union-find algorithm described in
+//  C. Berger, T. Geraud, R. Levillain, N. Widynski, A. Baillard, E. Bertin,
+//  "Effective Component Tree Computation with Application to Pattern Recognition in Astronomical Imaging",
+//  IEEE International Conference on Image Processing (2007) 41-44
+
+#ifndef __imgproc__maxtree__
+#define __imgproc__maxtree__
+
+#include <opencv/cv.h>
+#include <opencv/highgui.h>
+
+#include "utilities.h"
+#include "morph.h"
+
+#include <vector>
+
+namespace caib {
+
+    //Component tree of a grayscale image of 8-bit, 16-bit or finite float pixels (max-tree,
+    //or min-tree when built on the dual order)
+    class CAIB_EXPORTS MaxTree {
+    public:
+        MaxTree();
+        MaxTree(const cv::Mat &input, const bool &mintree = false, const cv::Mat &se = morphSedefault());
+
+        void build(const cv::Mat &input, const bool &mintree = false, const cv::Mat &se = morphSedefault());
+        cv::Mat areaFilter(const double &a) const;
+
+        bool empty() const { return sorted.empty(); }
+        int nodes() const;
+
+    private:
+        cv::Size size;
+        bool mintree;
+        cv::Mat values;             //gray level of each pixel, continuous
+        std::vector<int> sorted;    //pixels sorted from the root to the leaves
+        std::vector<int> parent;    //parent of each pixel, the canonical pixel of a node points to the parent node
+        std::vector<int> area;      //area of the node of each canonical pixel
+    };
+
+};
+
+#endif /* defined(__imgproc__maxtree__) */
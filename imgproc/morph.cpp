@@ -6,13 +6,1015 @@
 //  Copyright (c) 2014 CAIB. All rights reserved.
 //
 //  Note: All the morphological operations bellow that support grayscale images
-//  also support binary images.
+//  also support binary images. The erosions, dilatations, reconstructions, regional
+//  extrema and area filters also work on 16-bit and float grayscale images.
 //
 //  Name: Rômulo Bourget Novas
 //  Tel: +55 19 99735-7010
 //  Email: romulo.bnovas@gmail.com
 
 #include "morph.h"
+#include "maxtree.h"
+#include "kernels.h"
+#include "morphexpr.h"
+#include "bitmorph.h"
+
+/**
+ Hybrid reconstruction (L. Vincent, "Morphological grayscale reconstruction in image
+ analysis: applications and efficient algorithms", IEEE TIP 1993). A raster and an
+ anti-raster scan are followed by a FIFO propagation of the remaining changes
+ @param marker
+ Continuous marker image, already limited by the mask. Holds the result at the end
+ @param mask
+ Continuous mask image
+ @param se
+ Structurant element defining the neighbourhood
+ */
+template <class Order>
+void hybridReconstruction(cv::Mat &marker, const cv::Mat &mask, const cv::Mat &se) {
+    typedef typename Order::value_type T;
+
+    std::vector<cv::Point> offsets = caib::morphSeoffsets(se), before, after;
+
+    for (int i = 0; i < offsets.size(); i++) {
+        if ( offsets[i].y < 0 || (offsets[i].y == 0 && offsets[i].x < 0) )
+            before.push_back(offsets[i]);
+        else
+            after.push_back(offsets[i]);
+    }
+
+    const int cols = marker.cols, rows = marker.rows;
+    T *J = marker.ptr<T>();
+    const T *I = mask.ptr<T>();
+
+    //raster scan
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < cols; x++) {
+            int p = x + (y * cols);
+            T value = J[p];
+
+            for (int i = 0; i < before.size(); i++) {
+                int nx = x + before[i].x, ny = y + before[i].y;
+                if ( nx >= 0 && nx < cols && ny >= 0 && ny < rows )
+                    value = Order::extend(value, J[nx + (ny * cols)]);
+            }
+
+            J[p] = Order::clip(value, I[p]);
+        }
+    }
+
+    std::queue<int> fifo;
+
+    //anti-raster scan
+    for (int y = rows-1; y >= 0; y--) {
+        for (int x = cols-1; x >= 0; x--) {
+            int p = x + (y * cols);
+            T value = J[p];
+
+            for (int i = 0; i < after.size(); i++) {
+                int nx = x + after[i].x, ny = y + after[i].y;
+                if ( nx >= 0 && nx < cols && ny >= 0 && ny < rows )
+                    value = Order::extend(value, J[nx + (ny * cols)]);
+            }
+
+            J[p] = Order::clip(value, I[p]);
+
+            //pixels already scanned that could still be changed by p
+            for (int i = 0; i < before.size(); i++) {
+                int nx = x - before[i].x, ny = y - before[i].y;
+                if ( nx >= 0 && nx < cols && ny >= 0 && ny < rows ) {
+                    int q = nx + (ny * cols);
+                    if ( Order::below(J[q], J[p]) && J[q] != I[q] ) {
+                        fifo.push(p);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    //propagation
+    while ( !fifo.empty() ) {
+        int p = fifo.front();
+        fifo.pop();
+
+        int x = p % cols, y = p / cols;
+
+        for (int i = 0; i < offsets.size(); i++) {
+            int nx = x - offsets[i].x, ny = y - offsets[i].y;
+            if ( nx >= 0 && nx < cols && ny >= 0 && ny < rows ) {
+                int q = nx + (ny * cols);
+                if ( Order::below(J[q], J[p]) && J[q] != I[q] ) {
+                    J[q] = Order::clip(J[p], I[q]);
+                    fifo.push(q);
+                }
+            }
+        }
+    }
+}
+
+//First labelling pass over horizontal strips of a binary image
+class labelStripBody : public cv::ParallelLoopBody {
+public:
+    labelStripBody(const cv::Mat &_input, std::vector<int> &_parent, const std::vector<cv::Point> &_before, int _stripRows)
+    : input(_input), parent(&_parent), before(_before), stripRows(_stripRows) {}
+    
+    void operator()(const cv::Range &range) const {
+        const int cols = input.cols, rows = input.rows;
+        const uchar *in = input.ptr();
+        
+        for (int s = range.start; s < range.end; s++) {
+            int y0 = s * stripRows, y1 = std::min(rows, y0 + stripRows);
+            
+            for (int y = y0; y < y1; y++) {
+                for (int x = 0; x < cols; x++) {
+                    int p = x + (y * cols);
+                    
+                    if ( in[p] == 0 )
+                        continue;
+                    
+                    (*parent)[p] = p;
+                    
+                    for (int i = 0; i < before.size(); i++) {
+                        int nx = x + before[i].x, ny = y + before[i].y;
+                        if ( nx >= 0 && nx < cols && ny >= y0 && in[nx + (ny * cols)] != 0 )
+                            unionRoots(*parent, p, nx + (ny * cols));
+                    }
+                }
+            }
+        }
+    }
+    
+private:
+    const cv::Mat &input;
+    std::vector<int> *parent;
+    const std::vector<cv::Point> &before;
+    int stripRows;
+};
+
+//Horizontal van Herk/Gil-Werman pass over a range of rows
+template <class Order>
+class vhgwRowsBody : public cv::ParallelLoopBody {
+public:
+    vhgwRowsBody(const cv::Mat &_src, cv::Mat &_dst, int _k, int _anchor)
+    : src(_src), dst(&_dst), k(_k), anchor(_anchor) {}
+    
+    void operator()(const cv::Range &range) const {
+        typedef typename Order::value_type T;
+        std::vector<T> g(src.cols + k - 1), h(src.cols + k - 1);
+        
+        for (int y = range.start; y < range.end; y++)
+            vhgwLine<Order>(src.ptr<T>(y), dst->ptr<T>(y), src.cols, k, anchor, &g[0], &h[0]);
+    }
+    
+private:
+    const cv::Mat &src;
+    cv::Mat *dst;
+    int k, anchor;
+};
+
+//Vertical van Herk/Gil-Werman pass over a range of column strips, each
+//step works on a whole row of the strip so it can be vectorized
+template <class Order>
+class vhgwColsBody : public cv::ParallelLoopBody {
+public:
+    vhgwColsBody(const cv::Mat &_src, cv::Mat &_dst, int _k, int _anchor, int _stripCols)
+    : src(_src), dst(&_dst), k(_k), anchor(_anchor), stripCols(_stripCols) {}
+    
+    void operator()(const cv::Range &range) const {
+        typedef typename Order::value_type T;
+        const int rows = src.rows, len = src.rows + k - 1;
+        
+        std::vector<T> g(len * stripCols), h(len * stripCols), border(stripCols, Order::identity());
+        
+        for (int s = range.start; s < range.end; s++) {
+            int x0 = s * stripCols, w = std::min(src.cols, x0 + stripCols) - x0;
+            
+            for (int j = 0; j < len; j++) {
+                int i = j - anchor;
+                const T *f = ( i >= 0 && i < rows ) ? src.ptr<T>(i) + x0 : &border[0];
+                T *gj = &g[j * stripCols];
+                
+                if ( j % k == 0 ) {
+                    for (int x = 0; x < w; x++)
+                        gj[x] = f[x];
+                } else {
+                    const T *gp = gj - stripCols;
+                    for (int x = 0; x < w; x++)
+                        gj[x] = Order::extend(gp[x], f[x]);
+                }
+            }
+            
+            for (int j = len-1; j >= 0; j--) {
+                int i = j - anchor;
+                const T *f = ( i >= 0 && i < rows ) ? src.ptr<T>(i) + x0 : &border[0];
+                T *hj = &h[j * stripCols];
+                
+                if ( j % k == k-1 || j == len-1 ) {
+                    for (int x = 0; x < w; x++)
+                        hj[x] = f[x];
+                } else {
+                    const T *hn = hj + stripCols;
+                    for (int x = 0; x < w; x++)
+                        hj[x] = Order::extend(hn[x], f[x]);
+                }
+            }
+            
+            for (int i = 0; i < rows; i++) {
+                const T *hi = &h[i * stripCols], *gi = &g[(i + k - 1) * stripCols];
+                T *out = dst->ptr<T>(i) + x0;
+                for (int x = 0; x < w; x++)
+                    out[x] = Order::extend(hi[x], gi[x]);
+            }
+        }
+    }
+    
+private:
+    const cv::Mat &src;
+    cv::Mat *dst;
+    int k, anchor, stripCols;
+};
+
+/**
+ Order the runs of a structurant element by their horizontal extent
+ @param a
+ Run given as (left offset, right offset, row offset)
+ @param b
+ Run given as (left offset, right offset, row offset)
+ @return TRUE if a comes before b, FALSE if not
+ */
+bool compareRuns(const cv::Vec3i &a, const cv::Vec3i &b) {
+    if ( a[0] != b[0] )
+        return a[0] < b[0];
+    if ( a[1] != b[1] )
+        return a[1] < b[1];
+    return a[2] < b[2];
+}
+
+/**
+ Erosion (or dilatation) of a grayscale image by a full rectangle, as a horizontal
+ pass followed by a vertical pass of the van Herk/Gil-Werman algorithm
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image
+ @param size
+ Size of the rectangle
+ */
+template <class Order>
+void vhgwBox(const cv::Mat &input, cv::Mat &output, const cv::Size &size) {
+    cv::Mat temp = input;
+    
+    if ( size.width > 1 ) {
+        temp = cv::Mat(input.size(), input.type());
+        cv::parallel_for_(cv::Range(0, input.rows), vhgwRowsBody<Order>(input, temp, size.width, size.width/2));
+    }
+    
+    if ( size.height > 1 ) {
+        const int stripCols = 256;
+        cv::parallel_for_(cv::Range(0, (input.cols + stripCols - 1) / stripCols), vhgwColsBody<Order>(temp, output, size.height, size.height/2, stripCols));
+    } else {
+        temp.copyTo(output);
+    }
+}
+
+//Diagonal van Herk/Gil-Werman pass over a range of diagonals, the direction is
+//(1,1) for the main diagonals and (1,-1) for the anti-diagonals
+template <class Order>
+class vhgwDiagBody : public cv::ParallelLoopBody {
+public:
+    vhgwDiagBody(const cv::Mat &_src, cv::Mat &_dst, int _k, bool _anti)
+    : src(_src), dst(&_dst), k(_k), anti(_anti) {}
+    
+    void operator()(const cv::Range &range) const {
+        typedef typename Order::value_type T;
+        const int n = std::min(src.rows, src.cols);
+        std::vector<T> line(n), g(n + k - 1), h(n + k - 1);
+        
+        for (int d = range.start; d < range.end; d++) {
+            //first pixel of the diagonal
+            int x0, y0;
+            if ( !anti ) {
+                x0 = std::max(0, d - (src.rows - 1));
+                y0 = x0 - (d - (src.rows - 1));
+            } else {
+                x0 = std::max(0, d - (src.rows - 1));
+                y0 = d - x0;
+            }
+            
+            int len = 0;
+            for (int x = x0, y = y0; x < src.cols && y >= 0 && y < src.rows; x++, y += anti ? -1 : 1)
+                line[len++] = src.ptr<T>(y)[x];
+            
+            vhgwLine<Order>(&line[0], &line[0], len, k, k/2, &g[0], &h[0]);
+            
+            for (int i = 0, x = x0, y = y0; i < len; i++, x++, y += anti ? -1 : 1)
+                dst->ptr<T>(y)[x] = line[i];
+        }
+    }
+    
+private:
+    const cv::Mat &src;
+    cv::Mat *dst;
+    int k;
+    bool anti;
+};
+
+/**
+ Erosion (or dilatation) of a grayscale image by an octagon that approximates a disk.
+ The octagon is the Minkowski sum of a square, two diagonal lines and one or two small
+ crosses, each factor costs a constant number of comparisons per pixel
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image
+ @param radius
+ Radius of the disk
+ */
+template <class Order>
+void octagonMorph(const cv::Mat &input, cv::Mat &output, const int &radius) {
+    //the diamond part takes about 2r(1 - 1/sqrt(2)) of the radius
+    int k = cvRound( 2.0 * radius * (1.0 - 1.0/std::sqrt(2.0)) );
+    int m = radius - k;
+    
+    //the diagonal lines leave the image on the way, so the work is done on a
+    //copy surrounded by a border of the identity value
+    cv::Mat work = cv::Mat(input.rows + 2*k, input.cols + 2*k, input.type(), cv::Scalar(Order::identity()));
+    cv::Rect inner(k, k, input.cols, input.rows);
+    cv::Mat center = work(inner);
+    input.copyTo(center);
+    
+    if ( m > 0 )
+        vhgwBox<Order>(work.clone(), work, cv::Size(2*m+1, 2*m+1));
+    
+    if ( k > 0 ) {
+        int b = (k - 1) / 2;
+        
+        if ( b > 0 ) {
+            int ndiag = work.rows + work.cols - 1;
+            cv::parallel_for_(cv::Range(0, ndiag), vhgwDiagBody<Order>(work, work, 2*b+1, false));
+            cv::parallel_for_(cv::Range(0, ndiag), vhgwDiagBody<Order>(work, work, 2*b+1, true));
+        }
+        
+        for (int i = 2*b+1; i <= k; i++)
+            Order::apply(work.clone(), work, caib::morphSecross());
+    }
+    
+    work(inner).copyTo(output);
+}
+
+/**
+ Erosion (or dilatation) of a grayscale image by a structurant element whose rows are
+ single runs of pixels (disks, crosses, diamonds, ...). The element is the union of its
+ rows, so the result is the extension of the horizontal line passes shifted by the
+ row offsets. Each distinct run costs one van Herk/Gil-Werman pass
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image
+ @param se
+ Structurant element
+ @return TRUE if the element could be decomposed, FALSE if not
+ */
+template <class Order>
+bool rowsMorph(const cv::Mat &input, cv::Mat &output, const cv::Mat &se) {
+    std::vector<cv::Vec3i> runs; //(left offset, right offset, row offset)
+    cv::Point anchor(se.cols/2, se.rows/2);
+    
+    for (int y = 0; y < se.rows; y++) {
+        const uchar *row = se.ptr(y);
+        int j1 = 0, j2;
+        
+        while ( j1 < se.cols && row[j1] == 0 )
+            j1++;
+        if ( j1 == se.cols )
+            continue;
+        
+        j2 = j1;
+        while ( j2 < se.cols && row[j2] != 0 )
+            j2++;
+        for (int j = j2; j < se.cols; j++)
+            if ( row[j] != 0 )
+                return false;
+        
+        runs.push_back( cv::Vec3i(j1 - anchor.x, j2 - 1 - anchor.x, y - anchor.y) );
+    }
+    
+    std::sort(runs.begin(), runs.end(), compareRuns);
+    
+    output.setTo( cv::Scalar(Order::identity()) );
+    cv::Mat line = cv::Mat(input.size(), input.type());
+    
+    for (int i = 0; i < runs.size(); i++) {
+        if ( i == 0 || runs[i][0] != runs[i-1][0] || runs[i][1] != runs[i-1][1] )
+            cv::parallel_for_(cv::Range(0, input.rows), vhgwRowsBody<Order>(input, line, runs[i][1] - runs[i][0] + 1, -runs[i][0]));
+        
+        int dy = runs[i][2];
+        int y0 = std::max(0, -dy), y1 = std::min(input.rows, input.rows - dy);
+        if ( y0 >= y1 )
+            continue;
+        
+        cv::Mat out = output.rowRange(y0, y1);
+        Order::extend(out, line.rowRange(y0 + dy, y1 + dy), out);
+    }
+    
+    return true;
+}
+
+/**
+ Erosion (or dilatation) of a grayscale image through a decomposition of the structurant
+ element: full rectangles are separated in lines, crosses are the union of two lines,
+ other elements with single-run rows are the union of their rows and, when an
+ approximation is accepted, disks become octagons
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image
+ @param se
+ Structurant element
+ @param approx
+ Accept an approximated result for disks
+ @return TRUE if the element was decomposed, FALSE if it must be applied directly
+ */
+template <class Order>
+bool decomposedMorph(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const bool &approx) {
+    if ( !caib::isGray(se) || std::max(se.rows, se.cols) < VHGW_MINSIZE )
+        return false;
+    
+    if ( cv::countNonZero(se) == se.rows * se.cols ) {
+        vhgwBox<Order>(input, output, se.size());
+        return true;
+    }
+    
+    if ( se.rows != se.cols || se.rows % 2 == 0 )
+        return rowsMorph<Order>(input, output, se);
+    
+    int radius = se.rows / 2;
+    
+    if ( approx && caib::isEqual(se, caib::morphSedisk(radius)) ) {
+        octagonMorph<Order>(input, output, radius);
+        return true;
+    }
+    
+    if ( caib::isEqual(se, caib::morphSecross(radius)) ) {
+        cv::Mat line = cv::Mat(input.size(), input.type());
+        vhgwBox<Order>(input, output, cv::Size(se.cols, 1));
+        vhgwBox<Order>(input, line, cv::Size(1, se.rows));
+        Order::extend(output, line, output);
+        return true;
+    }
+    
+    return rowsMorph<Order>(input, output, se);
+}
+
+/**
+ Find the regional maxima (or minima) of a grayscale image by flooding each plateau once.
+ A plateau is an extremum when none of its neighbours is above it; plateaus at the
+ identity level are never extrema, as with the reconstruction by input - 1
+ @param input
+ Input grayscale image
+ @param se
+ Structurant element, its connectivity is made symmetric
+ @param output
+ Output image, binary (0 or 255) or labels of the extrema
+ @param labelled
+ Write the labels of the extrema, numbered from 1 following the column-major order
+ of their first pixel as morphLabel does
+ @return Number of extrema found
+ */
+template <class Order>
+int plateauExtrema(const cv::Mat &input, const cv::Mat &se, cv::Mat &output, const bool &labelled) {
+    typedef typename Order::value_type T;
+    cv::Mat image = input.isContinuous() ? input : input.clone();
+    const int cols = input.cols, rows = input.rows, sz = cols * rows;
+    const T *in = image.ptr<T>();
+    
+    std::vector<cv::Point> offsets = caib::morphSeoffsets(se);
+    for (int i = (int) offsets.size() - 1; i >= 0; i--) {
+        cv::Point o(-offsets[i].x, -offsets[i].y);
+        if ( std::find(offsets.begin(), offsets.end(), o) == offsets.end() )
+            offsets.push_back(o);
+    }
+    
+    output.create(input.size(), labelled ? (int) cv::DataType<int>::type : (int) cv::DataType<uchar>::type);
+    output.setTo(cv::Scalar(0));
+    
+    std::vector<uchar> visited(sz, 0);
+    std::vector<int> plateau(sz), keys;
+    int count = 0;
+    
+    for (int p0 = 0; p0 < sz; p0++) {
+        if ( visited[p0] )
+            continue;
+        
+        //flood the plateau of p0, the visited pixels are kept in order in plateau[0..tail)
+        const T v = in[p0];
+        bool extremum = ( v != Order::identity() );
+        int head = 0, tail = 0;
+        
+        plateau[tail++] = p0;
+        visited[p0] = 1;
+        
+        while ( head < tail ) {
+            int p = plateau[head++];
+            int x = p % cols, y = p / cols;
+            
+            for (int i = 0; i < offsets.size(); i++) {
+                int nx = x + offsets[i].x, ny = y + offsets[i].y;
+                if ( nx < 0 || nx >= cols || ny < 0 || ny >= rows )
+                    continue;
+                
+                int q = nx + (ny * cols);
+                if ( in[q] == v ) {
+                    if ( !visited[q] ) {
+                        visited[q] = 1;
+                        plateau[tail++] = q;
+                    }
+                } else if ( Order::below(v, in[q]) ) {
+                    extremum = false;
+                }
+            }
+        }
+        
+        if ( !extremum )
+            continue;
+        
+        count++;
+        
+        if ( labelled ) {
+            int *out = output.ptr<int>();
+            int key = sz;
+            
+            for (int i = 0; i < tail; i++) {
+                out[ plateau[i] ] = count;
+                key = std::min(key, (plateau[i] % cols) * rows + (plateau[i] / cols));
+            }
+            
+            keys.push_back(key);
+        } else {
+            uchar *out = output.ptr();
+            for (int i = 0; i < tail; i++)
+                out[ plateau[i] ] = 255;
+        }
+    }
+    
+    //renumber the labels following the column-major order of their first pixel
+    if ( labelled && count > 0 ) {
+        std::vector<std::pair<int, int> > order(count);
+        for (int i = 0; i < count; i++)
+            order[i] = std::make_pair(keys[i], i);
+        std::sort(order.begin(), order.end());
+        
+        std::vector<int> relabel(count + 1, 0);
+        for (int i = 0; i < count; i++)
+            relabel[ order[i].second + 1 ] = i + 1;
+        
+        int *out = output.ptr<int>();
+        for (int p = 0; p < sz; p++)
+            out[p] = relabel[ out[p] ];
+    }
+    
+    return count;
+}
+
+/**
+ Erosion (or dilatation) of a grayscale image with the kernels of its depth, 8-bit,
+ 16-bit or float. The structurant element is decomposed when possible
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, allocated with the size and type of the input
+ @param se
+ Structurant element
+ @param approx
+ Accept an approximated result for disks
+ */
+template <template <class> class Order>
+void depthMorph(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const bool &approx) {
+    switch ( input.depth() ) {
+        case CV_8U:
+            if ( !decomposedMorph<Order<uchar> >(input, output, se, approx) )
+                Order<uchar>::apply(input, output, se);
+            break;
+        case CV_16U:
+            if ( !decomposedMorph<Order<ushort> >(input, output, se, approx) )
+                Order<ushort>::apply(input, output, se);
+            break;
+        default:
+            if ( !decomposedMorph<Order<float> >(input, output, se, approx) )
+                Order<float>::apply(input, output, se);
+            break;
+    }
+}
+
+/**
+ Hybrid reconstruction with the kernels of the depth of the images
+ @param marker
+ Continuous marker image, already limited by the mask. Holds the result at the end
+ @param mask
+ Continuous mask image, of the same type as the marker
+ @param se
+ Structurant element defining the neighbourhood
+ */
+template <template <class> class Order>
+void depthReconstruction(cv::Mat &marker, const cv::Mat &mask, const cv::Mat &se) {
+    switch ( marker.depth() ) {
+        case CV_8U:
+            hybridReconstruction<Order<uchar> >(marker, mask, se);
+            break;
+        case CV_16U:
+            hybridReconstruction<Order<ushort> >(marker, mask, se);
+            break;
+        default:
+            hybridReconstruction<Order<float> >(marker, mask, se);
+            break;
+    }
+}
+
+/**
+ Regional maxima (or minima) with the kernels of the depth of the image
+ @param input
+ Input grayscale image
+ @param se
+ Structurant element
+ @param output
+ Output image, binary (0 or 255) or labels of the extrema
+ @param labelled
+ Write the labels of the extrema
+ @return Number of extrema found
+ */
+template <template <class> class Order>
+int depthExtrema(const cv::Mat &input, const cv::Mat &se, cv::Mat &output, const bool &labelled) {
+    switch ( input.depth() ) {
+        case CV_8U:
+            return plateauExtrema<Order<uchar> >(input, se, output, labelled);
+        case CV_16U:
+            return plateauExtrema<Order<ushort> >(input, se, output, labelled);
+        default:
+            return plateauExtrema<Order<float> >(input, se, output, labelled);
+    }
+}
+
+//Horizontal passes of the rows read by a geodesic step, one image for each distinct
+//run of the structurant element
+template <class Order>
+class geodesicLinesBody : public cv::ParallelLoopBody {
+public:
+    geodesicLinesBody(const cv::Mat &_src, std::vector<cv::Mat> &_lines, const std::vector<cv::Vec2i> &_shapes, const std::vector<uchar> &_needed)
+    : src(_src), lines(&_lines), shapes(_shapes), needed(_needed) {}
+    
+    void operator()(const cv::Range &range) const {
+        typedef typename Order::value_type T;
+        std::vector<T> g(src.cols + 1), h(src.cols + 1);
+        
+        for (int y = range.start; y < range.end; y++) {
+            if ( !needed[y] )
+                continue;
+            
+            for (int s = 0; s < shapes.size(); s++) {
+                //single pixels are read from the source itself
+                if ( shapes[s][0] == 0 && shapes[s][1] == 0 )
+                    continue;
+                
+                int k = shapes[s][1] - shapes[s][0] + 1;
+                if ( g.size() < src.cols + k - 1 ) {
+                    g.resize(src.cols + k - 1);
+                    h.resize(src.cols + k - 1);
+                }
+                
+                vhgwLine<Order>(src.ptr<T>(y), (*lines)[s].ptr<T>(y), src.cols, k, -shapes[s][0], &g[0], &h[0]);
+            }
+        }
+    }
+    
+private:
+    const cv::Mat &src;
+    std::vector<cv::Mat> *lines;
+    const std::vector<cv::Vec2i> &shapes;
+    const std::vector<uchar> &needed;
+};
+
+//Rows of a geodesic step: extension of the shifted horizontal passes limited by the
+//mask, each row computed records if it changed
+template <class Order>
+class geodesicRowsBody : public cv::ParallelLoopBody {
+public:
+    geodesicRowsBody(const cv::Mat &_src, const std::vector<cv::Mat> &_lines, const std::vector<cv::Vec4i> &_runs, const cv::Mat &_mask,
+                     cv::Mat &_dst, const std::vector<uchar> &_compute, std::vector<uchar> &_changed)
+    : src(_src), lines(_lines), runs(_runs), mask(_mask), dst(&_dst), compute(_compute), changed(&_changed) {}
+    
+    void operator()(const cv::Range &range) const {
+        typedef typename Order::value_type T;
+        const int cols = src.cols, rows = src.rows;
+        
+        for (int y = range.start; y < range.end; y++) {
+            (*changed)[y] = 0;
+            if ( !compute[y] )
+                continue;
+            
+            T *d = dst->ptr<T>(y);
+            std::fill(d, d + cols, Order::identity());
+            
+            for (int i = 0; i < runs.size(); i++) {
+                int yy = y + runs[i][2];
+                if ( yy < 0 || yy >= rows )
+                    continue;
+                
+                const cv::Mat &line = lines[ runs[i][3] ].empty() ? src : lines[ runs[i][3] ];
+                const T *l = line.ptr<T>(yy);
+                for (int x = 0; x < cols; x++)
+                    d[x] = Order::extend(d[x], l[x]);
+            }
+            
+            const T *m = mask.ptr<T>(y), *a = src.ptr<T>(y);
+            bool diff = false;
+            for (int x = 0; x < cols; x++) {
+                d[x] = Order::clip(d[x], m[x]);
+                diff = diff || ( d[x] != a[x] );
+            }
+            
+            (*changed)[y] = diff ? 1 : 0;
+        }
+    }
+    
+private:
+    const cv::Mat &src;
+    const std::vector<cv::Mat> &lines;
+    const std::vector<cv::Vec4i> &runs;
+    const cv::Mat &mask;
+    cv::Mat *dst;
+    const std::vector<uchar> &compute;
+    std::vector<uchar> *changed;
+};
+
+/**
+ Geodesic dilatation (or erosion) of n steps, each step is the dilatation of the previous
+ one limited by the mask. The steps alternate between two images and only compute the
+ rows whose neighbourhood changed in the previous step, stopping when nothing changes
+ @param marker
+ Marker image, already limited by the mask. Used as one of the two images
+ @param mask
+ Mask image
+ @param se
+ Structurant element
+ @param n
+ Number of steps
+ @return Image holding the result, the marker or a new image
+ */
+template <class Order>
+cv::Mat geodesicSteps(cv::Mat &marker, const cv::Mat &mask, const cv::Mat &se, const int &n) {
+    const int rows = marker.rows;
+    
+    //runs given as (left offset, right offset, row offset, shape)
+    std::vector<cv::Vec3i> seRuns = caib::morphSeruns(se);
+    std::vector<cv::Vec2i> shapes;
+    std::vector<cv::Vec4i> runs;
+    std::vector<int> dys(1, 0);
+    
+    for (int i = 0; i < seRuns.size(); i++) {
+        int s = 0;
+        while ( s < shapes.size() && (shapes[s][0] != seRuns[i][0] || shapes[s][1] != seRuns[i][1]) )
+            s++;
+        if ( s == shapes.size() )
+            shapes.push_back( cv::Vec2i(seRuns[i][0], seRuns[i][1]) );
+        
+        runs.push_back( cv::Vec4i(seRuns[i][0], seRuns[i][1], seRuns[i][2], s) );
+        if ( std::find(dys.begin(), dys.end(), seRuns[i][2]) == dys.end() )
+            dys.push_back(seRuns[i][2]);
+    }
+    
+    std::vector<cv::Mat> lines(shapes.size());
+    for (int s = 0; s < shapes.size(); s++)
+        if ( shapes[s][0] != 0 || shapes[s][1] != 0 )
+            lines[s] = cv::Mat(marker.size(), marker.type());
+    
+    cv::Mat buffers[2] = { marker, cv::Mat(marker.size(), marker.type()) };
+    std::vector<uchar> changed(rows, 1), compute(rows), needed(rows);
+    int cur = 0;
+    
+    for (int i = 0; i < n; i++) {
+        //a row can only change if a row of its neighbourhood changed, the row itself
+        //must be unchanged to be skipped since the other image holds its older value
+        bool any = false;
+        std::fill(needed.begin(), needed.end(), (uchar)0);
+        
+        for (int y = 0; y < rows; y++) {
+            compute[y] = 0;
+            for (int j = 0; j < dys.size() && !compute[y]; j++) {
+                int yy = y + dys[j];
+                if ( yy >= 0 && yy < rows && changed[yy] )
+                    compute[y] = 1;
+            }
+            
+            if ( !compute[y] )
+                continue;
+            
+            any = true;
+            for (int j = 0; j < dys.size(); j++) {
+                int yy = y + dys[j];
+                if ( yy >= 0 && yy < rows )
+                    needed[yy] = 1;
+            }
+        }
+        
+        if ( !any )
+            break;
+        
+        cv::parallel_for_(cv::Range(0, rows), geodesicLinesBody<Order>(buffers[cur], lines, shapes, needed));
+        cv::parallel_for_(cv::Range(0, rows), geodesicRowsBody<Order>(buffers[cur], lines, runs, mask, buffers[1-cur], compute, changed));
+        cur = 1 - cur;
+    }
+    
+    return buffers[cur];
+}
+
+/**
+ Geodesic dilatation (or erosion) of n steps by propagation: only the pixels changed by
+ a step can change their neighbours in the next one, so each step visits the front of
+ the changes instead of the whole image. The first front is made of the pixels above
+ the identity value. Requires a structurant element holding its anchor
+ @param marker
+ Continuous marker image, already limited by the mask. Holds the result at the end
+ @param mask
+ Continuous mask image
+ @param se
+ Structurant element
+ @param n
+ Number of steps
+ */
+template <class Order>
+void geodesicFront(cv::Mat &marker, const cv::Mat &mask, const cv::Mat &se, const int &n) {
+    typedef typename Order::value_type T;
+    
+    std::vector<cv::Point> offsets = caib::morphSeoffsets(se);
+    const int cols = marker.cols, rows = marker.rows, sz = cols * rows;
+    T *J = marker.ptr<T>();
+    const T *I = mask.ptr<T>();
+    
+    std::vector<int> front, next, stamp(sz, -1);
+    std::vector<T> values;
+    
+    for (int p = 0; p < sz; p++)
+        if ( J[p] != Order::identity() )
+            front.push_back(p);
+    
+    for (int i = 0; i < n && !front.empty(); i++) {
+        //the values of the previous step, the front can be changed along the step
+        values.resize(front.size());
+        for (int k = 0; k < front.size(); k++)
+            values[k] = J[ front[k] ];
+        
+        next.clear();
+        
+        for (int k = 0; k < front.size(); k++) {
+            int x = front[k] % cols, y = front[k] / cols;
+            
+            for (int j = 0; j < offsets.size(); j++) {
+                int nx = x - offsets[j].x, ny = y - offsets[j].y;
+                if ( nx < 0 || nx >= cols || ny < 0 || ny >= rows )
+                    continue;
+                
+                int q = nx + (ny * cols);
+                T v = Order::clip(values[k], I[q]);
+                
+                if ( Order::below(J[q], v) ) {
+                    J[q] = v;
+                    if ( stamp[q] != i ) {
+                        stamp[q] = i;
+                        next.push_back(q);
+                    }
+                }
+            }
+        }
+        
+        front.swap(next);
+    }
+}
+
+/**
+ Geodesic dilatation (or erosion) of n steps with the kernels of the depth of the images
+ @param marker
+ Marker image, already limited by the mask
+ @param mask
+ Mask image, of the same type as the marker
+ @param se
+ Structurant element
+ @param n
+ Number of steps
+ @param propagate
+ Propagate the changes from pixel to pixel instead of computing whole rows, both images
+ must be continuous
+ @return Image holding the result, the marker or a new image
+ */
+template <template <class> class Order>
+cv::Mat depthGeodesic(cv::Mat &marker, const cv::Mat &mask, const cv::Mat &se, const int &n, const bool &propagate) {
+    if ( propagate ) {
+        switch ( marker.depth() ) {
+            case CV_8U:
+                geodesicFront<Order<uchar> >(marker, mask, se, n);
+                break;
+            case CV_16U:
+                geodesicFront<Order<ushort> >(marker, mask, se, n);
+                break;
+            default:
+                geodesicFront<Order<float> >(marker, mask, se, n);
+                break;
+        }
+        
+        return marker;
+    }
+    
+    switch ( marker.depth() ) {
+        case CV_8U:
+            return geodesicSteps<Order<uchar> >(marker, mask, se, n);
+        case CV_16U:
+            return geodesicSteps<Order<ushort> >(marker, mask, se, n);
+        default:
+            return geodesicSteps<Order<float> >(marker, mask, se, n);
+    }
+}
+
+/**
+ Flood a bit-packed binary image from its border, the frame of the image is
+ reconstructed inside the mask 64 pixels at a time
+ @param mask
+ Input bit-packed binary image
+ @param se
+ Structurant element
+ @return Pixels of the mask reached from the border
+ */
+caib::BitMask borderFlood(const caib::BitMask &mask, const cv::Mat &se) {
+    caib::BitMask frame(mask.size());
+    frame.setFrame();
+    
+    return frame.reconstruct(mask, se);
+}
+
+/**
+ Reconstruction of a grayscale image from its border with a hierarchical queue. The
+ border pixels keep their value, the other pixels are reached level by level, from the
+ bottom for the superior reconstruction and from the top for the inferior one, so each
+ pixel is queued only once
+ @param input
+ Input grayscale image
+ @param se
+ Structurant element
+ @param output
+ Output grayscale image
+ */
+template <class Order>
+void borderReconstruction(const cv::Mat &input, const cv::Mat &se, cv::Mat &output) {
+    cv::Mat image = input.isContinuous() ? input : input.clone();
+    const int cols = input.cols, rows = input.rows;
+    const uchar *in = image.ptr();
+    
+    std::vector<cv::Point> offsets = caib::morphSeoffsets(se);
+    std::vector<std::vector<int> > levels(256);
+    
+    //the pixels never reached keep the value of the marker inside the border
+    output.create(input.size(), cv::DataType<uchar>::type);
+    output.setTo(cv::Scalar(Order::identity()));
+    uchar *out = output.ptr();
+    std::vector<uchar> queued(cols * rows, 0);
+    
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < cols; x++) {
+            if ( y == 0 || y == rows-1 || x == 0 || x == cols-1 ) {
+                int p = x + (y * cols);
+                out[p] = in[p];
+                queued[p] = 1;
+                levels[ in[p] ].push_back(p);
+            }
+        }
+    }
+    
+    for (int i = 0; i < 256; i++) {
+        //the dilatation order takes the levels from the top
+        int level = ( Order::identity() == 0 ) ? 255 - i : i;
+        std::vector<int> &fifo = levels[level];
+        
+        for (int j = 0; j < fifo.size(); j++) {
+            int p = fifo[j];
+            int x = p % cols, y = p / cols;
+            
+            for (int k = 0; k < offsets.size(); k++) {
+                int nx = x - offsets[k].x, ny = y - offsets[k].y;
+                if ( nx < 0 || nx >= cols || ny < 0 || ny >= rows )
+                    continue;
+                
+                int q = nx + (ny * cols);
+                if ( queued[q] )
+                    continue;
+                
+                queued[q] = 1;
+                out[q] = Order::clip(in[q], (uchar)level);
+                levels[ out[q] ].push_back(q);
+            }
+        }
+        
+        std::vector<int>().swap(fifo);
+    }
+}
 
 /**
  Transform a grascale image to binary by applying an threshold operation
@@ -23,12 +1025,26 @@
  @return Ouput binary image
  */
 cv::Mat caib::morphBinary(const cv::Mat &input, const double &r) {
+    cv::Mat output;
+    caib::morphBinary(input, output, r);
+    
+    return output;
+}
+
+/**
+ Transform a grascale image to binary by applying an threshold operation, in place if
+ the output is the input
+ @param input
+ Input grayscale image
+ @param output
+ Output binary image, reused if it has the right size and type
+ @param r
+ The threshold value
+ */
+void caib::morphBinary(const cv::Mat &input, cv::Mat &output, const double &r) {
     CV_Assert( caib::isGray(input) );
     
-    cv::Mat output = cv::Mat(input.size(), cv::DataType<uchar>::type);
     cv::threshold(input, output, r, 255, cv::THRESH_BINARY);
-    
-    return output;
 }
 
 /**
@@ -41,14 +1057,27 @@ cv::Mat caib::morphBinary(const cv::Mat &input, const double &r) {
  @return Ouput grayscale image
  */
 cv::Mat caib::morphIntersec(const cv::Mat &input1, const cv::Mat &input2) {
-    CV_Assert( (caib::isGray(input1) || caib::isGray(input2)) && input1.cols == input2.cols && input1.rows == input2.rows );
-    
-    cv::Mat output = cv::Mat(input1.size(), cv::DataType<uchar>::type);
-    cv::min(input1, input2, output);
+    cv::Mat output;
+    caib::morphIntersec(input1, input2, output);
     
     return output;
 }
 
+/**
+ Intersection of two grayscale images, in place if the output is one of the inputs
+ @param input1
+ Input grayscale image
+ @param input2
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ */
+void caib::morphIntersec(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output) {
+    CV_Assert( caib::isIntensity(input1) && input1.type() == input2.type() && input1.cols == input2.cols && input1.rows == input2.rows );
+    
+    cv::min(input1, input2, output);
+}
+
 /**
  Union of two grayscale images, to binary images this is equivalent
  to apply the operation OR to each pixel
@@ -59,13 +1088,25 @@ cv::Mat caib::morphIntersec(const cv::Mat &input1, const cv::Mat &input2) {
  @return Ouput grayscale image
  */
 cv::Mat caib::morphUnion(const cv::Mat &input1, const cv::Mat &input2) {
-    CV_Assert( (caib::isGray(input1) || caib::isGray(input2)) && input1.cols == input2.cols && input1.rows == input2.rows );
-    
-    cv::Mat output = cv::Mat(input1.size(), cv::DataType<uchar>::type);
-    cv::max(input1, input2, output);
+    cv::Mat output;
+    caib::morphUnion(input1, input2, output);
     
     return output;
+}
+
+/**
+ Union of two grayscale images, in place if the output is one of the inputs
+ @param input1
+ Input grayscale image
+ @param input2
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ */
+void caib::morphUnion(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output) {
+    CV_Assert( caib::isIntensity(input1) && input1.type() == input2.type() && input1.cols == input2.cols && input1.rows == input2.rows );
     
+    cv::max(input1, input2, output);
 }
 
 /**
@@ -75,21 +1116,111 @@ Invert the pixels values of a grayscale image
  @return Ouput grayscale image
  */
 cv::Mat caib::morphNeg(const cv::Mat &input) {
-    CV_Assert( caib::isGray(input) );
+    cv::Mat output;
+    caib::morphNeg(input, output);
+    
+    return output;
+}
 
-    return 255 - input;
+/**
+ Invert the pixels values of a grayscale image, in place if the output is the input
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ */
+void caib::morphNeg(const cv::Mat &input, cv::Mat &output) {
+    CV_Assert( caib::isIntensity(input) );
+    
+    //on integer images max - v is the complement of the bits of v, float images
+    //are negated
+    if ( input.depth() == CV_32F )
+        cv::subtract(cv::Scalar(0), input, output);
+    else
+        cv::bitwise_not(input, output);
+}
+
+/**
+ Calculate the symetrical difference of two grayscale images
+ @param input1
+ Input grayscale image
+ @param input2
+ Input grayscale image
+ @return Ouput grayscale image
+ */
+cv::Mat caib::morphSymdif( const cv::Mat &input1, const cv::Mat &input2) {
+    cv::Mat output;
+    caib::morphSymdif(input1, input2, output);
+    
+    return output;
 }
 
 /**
- Calculate the symetrical difference of two grayscale images
+ Calculate the symetrical difference of two grayscale images, the output can be one
+ of the inputs
  @param input1
  Input grayscale image
  @param input2
  Input grayscale image
- @return Ouput grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
  */
-cv::Mat caib::morphSymdif( const cv::Mat &input1, const cv::Mat &input2) {
-    return caib::morphUnion((input1 - input2), (input2 - input1));
+void caib::morphSymdif(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output) {
+    caib::MorphExpr a(input1), b(input2);
+    (a - b).unite(b - a).eval(output);
+}
+
+/**
+ Get the neighbourhood of a structurant element as offsets relative to its anchor
+ (the anchor itself is not included)
+ @param se
+ Structurant element
+ @return Offsets of the neighbours
+ */
+std::vector<cv::Point> caib::morphSeoffsets(const cv::Mat &se) {
+    CV_Assert( caib::isGray(se) );
+    
+    std::vector<cv::Point> offsets;
+    cv::Point anchor(se.cols/2, se.rows/2);
+    
+    for (int y = 0; y < se.rows; y++) {
+        for (int x = 0; x < se.cols; x++) {
+            if ( se.ptr(y)[x] != 0 && !(x == anchor.x && y == anchor.y) )
+                offsets.push_back( cv::Point(x - anchor.x, y - anchor.y) );
+        }
+    }
+    
+    return offsets;
+}
+
+/**
+ Split a structurant element in horizontal runs of pixels
+ @param se
+ Structurant element
+ @return Runs given as (left offset, right offset, row offset) relative to the anchor
+ */
+std::vector<cv::Vec3i> caib::morphSeruns(const cv::Mat &se) {
+    CV_Assert( caib::isGray(se) );
+    
+    std::vector<cv::Vec3i> runs;
+    cv::Point anchor(se.cols/2, se.rows/2);
+    
+    for (int y = 0; y < se.rows; y++) {
+        const uchar *row = se.ptr(y);
+        
+        for (int x = 0; x < se.cols; x++) {
+            if ( row[x] == 0 )
+                continue;
+            
+            int x0 = x;
+            while ( x + 1 < se.cols && row[x+1] != 0 )
+                x++;
+            
+            runs.push_back( cv::Vec3i(x0 - anchor.x, x - anchor.x, y - anchor.y) );
+        }
+    }
+    
+    return runs;
 }
 
 /**
@@ -125,40 +1256,97 @@ cv::Mat caib::morphSedisk(const int &size) {
                                      cv::Point( size, size) );
 }
 
+/**
+ Default structurant element of the operations, a box of size 1. It is built only
+ once, so the calls relying on the default do not allocate it again
+ @return Structurant element, shared by all the calls
+ */
+const cv::Mat &caib::morphSedefault() {
+    static const cv::Mat se = caib::morphSebox();
+
+    return se;
+}
+
 /**
  Apply the mathematical morphology erosion on a grayscale image
  @param input
  Input grayscale image
  @param se
  Structurant Element
+ @param approx
+ Approximate large disks by octagons
  @return Ouput grayscale image
  */
-cv::Mat caib::morphEro(const cv::Mat &input, const cv::Mat &se) {
-    CV_Assert( caib::isGray(input) );
-    
-    cv::Mat output = cv::Mat(input.size(), cv::DataType<uchar>::type);
-    cv::erode( input, output, se);
+cv::Mat caib::morphEro(const cv::Mat &input, const cv::Mat &se, const bool &approx) {
+    cv::Mat output;
+    caib::morphEro(input, output, se, approx);
     
     return output;
 }
 
+/**
+ Apply the mathematical morphology erosion on a grayscale image, the output can be
+ the input
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param se
+ Structurant Element
+ @param approx
+ Approximate large disks by octagons
+ */
+void caib::morphEro(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const bool &approx) {
+    CV_Assert( caib::isIntensity(input) );
+    
+    cv::Mat result = resultHeader(output, input, false);
+    result.create(input.size(), input.type());
+    
+    depthMorph<eroOrder>(input, result, se, approx);
+    
+    storeResult(result, output);
+}
+
 /**
  Apply the mathematical morphology dilatation on a grayscale image
  @param input
  Input grayscale image
  @param se
  Structurant Element
+ @param approx
+ Approximate large disks by octagons
  @return Ouput grayscale image
  */
-cv::Mat caib::morphDil(const cv::Mat &input, const cv::Mat &se) {
-    CV_Assert( caib::isGray(input) );
-    
-    cv::Mat output = cv::Mat(input.size(), cv::DataType<uchar>::type);
-    cv::dilate(input, output, se);
+cv::Mat caib::morphDil(const cv::Mat &input, const cv::Mat &se, const bool &approx) {
+    cv::Mat output;
+    caib::morphDil(input, output, se, approx);
     
     return output;
 }
 
+/**
+ Apply the mathematical morphology dilatation on a grayscale image, the output can be
+ the input
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param se
+ Structurant Element
+ @param approx
+ Approximate large disks by octagons
+ */
+void caib::morphDil(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const bool &approx) {
+    CV_Assert( caib::isIntensity(input) );
+    
+    cv::Mat result = resultHeader(output, input, false);
+    result.create(input.size(), input.type());
+    
+    depthMorph<dilOrder>(input, result, se, approx);
+    
+    storeResult(result, output);
+}
+
 /**
  Apply the mathematical morphology erosion on a grayscale image condionated
  to another grayscale image
@@ -170,17 +1358,49 @@ cv::Mat caib::morphDil(const cv::Mat &input, const cv::Mat &se) {
  Structurant element
  @param n
  Number of interations
+ @param propagate
+ Propagate the changes of each step instead of computing whole rows
  @return Ouput grayscale image
  */
-cv::Mat caib::morphCero(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se, const int &n) {
-    cv::Mat output = caib::morphUnion(input1, input2);
-    
-    for (int i=0; i<n; i++)
-        output = caib::morphUnion(caib::morphEro(output, se), input2 );
+cv::Mat caib::morphCero(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se, const int &n, const bool &propagate) {
+    cv::Mat output;
+    caib::morphCero(input1, input2, output, se, n, propagate);
     
     return output;
 }
 
+/**
+ Apply the mathematical morphology erosion on a grayscale image condionated to another
+ grayscale image, the output can be the first input. The n steps are done in two images
+ and skip the rows that can not change. With the propagation only the pixels changed by
+ a step are visited in the next one, so the cost follows the size of the changes
+ instead of n times the image size
+ @param input1
+ Input grayscale image
+ @param input2
+ Input grayscale image that will be used as condition
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param se
+ Structurant element
+ @param n
+ Number of interations
+ @param propagate
+ Propagate the changes of each step instead of computing whole rows. Structurant
+ elements without their anchor always compute whole rows
+ */
+void caib::morphCero(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output, const cv::Mat &se, const int &n, const bool &propagate) {
+    CV_Assert( caib::isIntensity(input1) && input1.type() == input2.type() && input1.size() == input2.size() );
+    
+    //the condition is read at every step, the propagation works on continuous images
+    bool front = propagate && se.ptr(se.rows/2)[se.cols/2] != 0;
+    cv::Mat mask = ( (input2.isContinuous() || !front) && !sharesData(input2, output) ) ? input2 : input2.clone();
+    cv::Mat result = resultHeader(output, cv::Mat(), front);
+    caib::morphUnion(input1, mask, result);
+    
+    storeResult(depthGeodesic<eroOrder>(result, mask, se, n, front), output);
+}
+
 /**
  Apply the mathematical morphology dilatation on a grayscale image condionated
  to another grayscale image
@@ -192,27 +1412,80 @@ cv::Mat caib::morphCero(const cv::Mat &input1, const cv::Mat &input2, const cv::
  Structurant element
  @param n
  Number of interations
+ @param propagate
+ Propagate the changes of each step instead of computing whole rows
  @return Ouput grayscale image
  */
-cv::Mat caib::morphCdil(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se, const int &n) {
-    cv::Mat output = caib::morphIntersec(input1, input2);
-    
-    for (int i=0; i<n; i++)
-        output = caib::morphIntersec(caib::morphDil(output, se), input2 );
+cv::Mat caib::morphCdil(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se, const int &n, const bool &propagate) {
+    cv::Mat output;
+    caib::morphCdil(input1, input2, output, se, n, propagate);
     
     return output;
 }
 
+/**
+ Apply the mathematical morphology dilatation on a grayscale image condionated to another
+ grayscale image, the output can be the first input. The n steps are done in two images
+ and skip the rows that can not change. With the propagation only the pixels changed by
+ a step are visited in the next one, so the cost follows the size of the changes
+ instead of n times the image size
+ @param input1
+ Input grayscale image
+ @param input2
+ Input grayscale image that will be used as condition
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param se
+ Structurant element
+ @param n
+ Number of interations
+ @param propagate
+ Propagate the changes of each step instead of computing whole rows. Structurant
+ elements without their anchor always compute whole rows
+ */
+void caib::morphCdil(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output, const cv::Mat &se, const int &n, const bool &propagate) {
+    CV_Assert( caib::isIntensity(input1) && input1.type() == input2.type() && input1.size() == input2.size() );
+    
+    //the condition is read at every step, the propagation works on continuous images
+    bool front = propagate && se.ptr(se.rows/2)[se.cols/2] != 0;
+    cv::Mat mask = ( (input2.isContinuous() || !front) && !sharesData(input2, output) ) ? input2 : input2.clone();
+    cv::Mat result = resultHeader(output, cv::Mat(), front);
+    caib::morphIntersec(input1, mask, result);
+    
+    storeResult(depthGeodesic<dilOrder>(result, mask, se, n, front), output);
+}
+
 /**
  Apply the mathematical morpholoy opening on a grayscale image
  @param input
  Input grayscale image
  @param se
  Structurant element
+ @param approx
+ Approximate large disks by octagons
  @return Ouput grayscale image
  */
-cv::Mat caib::morphOpen(const cv::Mat &input, const cv::Mat &se) {
-    return caib::morphDil( caib::morphEro(input, se), se );
+cv::Mat caib::morphOpen(const cv::Mat &input, const cv::Mat &se, const bool &approx) {
+    cv::Mat output;
+    caib::morphOpen(input, output, se, approx);
+    
+    return output;
+}
+
+/**
+ Apply the mathematical morphology opening on a grayscale image, the output can be
+ the input
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param se
+ Structurant element
+ @param approx
+ Approximate large disks by octagons
+ */
+void caib::morphOpen(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const bool &approx) {
+    caib::MorphExpr(input).open(se, approx).eval(output);
 }
 
 /**
@@ -221,10 +1494,31 @@ cv::Mat caib::morphOpen(const cv::Mat &input, const cv::Mat &se) {
  Input grayscale image
  @param se
  Structurant element
+ @param approx
+ Approximate large disks by octagons
  @return Ouput grayscale image
  */
-cv::Mat caib::morphClose(const cv::Mat &input, const cv::Mat &se) {
-    return caib::morphEro( caib::morphDil(input, se), se );
+cv::Mat caib::morphClose(const cv::Mat &input, const cv::Mat &se, const bool &approx) {
+    cv::Mat output;
+    caib::morphClose(input, output, se, approx);
+    
+    return output;
+}
+
+/**
+ Apply the mathematical morphology closing on a grayscale image, the output can be
+ the input
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param se
+ Structurant element
+ @param approx
+ Approximate large disks by octagons
+ */
+void caib::morphClose(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const bool &approx) {
+    caib::MorphExpr(input).close(se, approx).eval(output);
 }
 
 /**
@@ -238,19 +1532,37 @@ cv::Mat caib::morphClose(const cv::Mat &input, const cv::Mat &se) {
  @return Ouput grayscale image
  */
 cv::Mat caib::morphSuprec(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se) {
-    cv::Mat output = input1;
-    
-    while ( true ) {
-        cv::Mat temp = output;
-        output = caib::morphCero(temp, input2, se);
-        
-        if ( caib::isEqual(output, temp) )
-            break;
-    }
+    cv::Mat output;
+    caib::morphSuprec(input1, input2, output, se);
     
     return output;
 }
 
+/**
+ Apply the mathematical morphology superior reconstuction of a grayscale image form another
+ grayscale image, the output can be any of the inputs
+ @param input1
+ Grayscale image that will be used to recontruct another image
+ @param input2
+ Grasycale image that will be reconstructed from another image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param se
+ Structurant element
+ */
+void caib::morphSuprec(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output, const cv::Mat &se) {
+    CV_Assert( caib::isIntensity(input1) && input1.type() == input2.type() && input1.size() == input2.size() );
+    
+    //the mask is read during the whole reconstruction
+    cv::Mat mask = ( input2.isContinuous() && !sharesData(input2, output) ) ? input2 : input2.clone();
+    cv::Mat result = resultHeader(output, cv::Mat(), true);
+    caib::morphUnion(input1, mask, result);
+    
+    depthReconstruction<eroOrder>(result, mask, se);
+    
+    storeResult(result, output);
+}
+
 /**
  Apply the mathematical morphology inferior reconstuction of a grayscale image form another grayscale image
  @param input1
@@ -262,19 +1574,37 @@ cv::Mat caib::morphSuprec(const cv::Mat &input1, const cv::Mat &input2, const cv
  @return Output grayscale image
  */
 cv::Mat caib::morphInfrec(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se) {
-    cv::Mat output = input1;
-    
-    while ( true ) {
-        cv::Mat temp = output;
-        output = caib::morphCdil(temp, input2, se);
-        
-        if ( caib::isEqual(output, temp) )
-            break;
-    }
+    cv::Mat output;
+    caib::morphInfrec(input1, input2, output, se);
     
     return output;
 }
 
+/**
+ Apply the mathematical morphology inferior reconstuction of a grayscale image form another
+ grayscale image, the output can be any of the inputs
+ @param input1
+ Grayscale image that will be used to recontruct another image
+ @param input2
+ Grasycale image that will be reconstructed from another image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param se
+ Structurant element
+ */
+void caib::morphInfrec(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output, const cv::Mat &se) {
+    CV_Assert( caib::isIntensity(input1) && input1.type() == input2.type() && input1.size() == input2.size() );
+    
+    //the mask is read during the whole reconstruction
+    cv::Mat mask = ( input2.isContinuous() && !sharesData(input2, output) ) ? input2 : input2.clone();
+    cv::Mat result = resultHeader(output, cv::Mat(), true);
+    caib::morphIntersec(input1, mask, result);
+    
+    depthReconstruction<dilOrder>(result, mask, se);
+    
+    storeResult(result, output);
+}
+
 /**
  Apply the mathematical morphology opening by reconstrution operation to a grayscale image
  @param input
@@ -286,7 +1616,29 @@ cv::Mat caib::morphInfrec(const cv::Mat &input1, const cv::Mat &input2, const cv
  @return Ouput grayscale image
  */
 cv::Mat caib::morphOpenrec(const cv::Mat &input, const cv::Mat &eroSe, const cv::Mat &infrecSe) {
-    return caib::morphInfrec(caib::morphEro(input, eroSe), input, infrecSe);
+    cv::Mat output;
+    caib::morphOpenrec(input, output, eroSe, infrecSe);
+    
+    return output;
+}
+
+/**
+ Apply the mathematical morphology opening by reconstrution operation to a grayscale image,
+ the output can be the input
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param eroSe
+ Structurant element of the erosion
+ @param infrecSe
+ Structurant element of the inferior reconstruction
+ */
+void caib::morphOpenrec(const cv::Mat &input, cv::Mat &output, const cv::Mat &eroSe, const cv::Mat &infrecSe) {
+    //the marker is built in the output, the reconstruction works in place over it
+    cv::Mat marker = resultHeader(output, input, false);
+    caib::morphEro(input, marker, eroSe);
+    caib::morphInfrec(marker, input, output, infrecSe);
 }
 
 /**
@@ -300,7 +1652,29 @@ cv::Mat caib::morphOpenrec(const cv::Mat &input, const cv::Mat &eroSe, const cv:
  @return Ouput grayscale image
  */
 cv::Mat caib::morphCloserec(const cv::Mat &input, const cv::Mat &dilSe, const cv::Mat &suprecSe) {
-    return caib::morphSuprec(caib::morphDil(input, dilSe), input, suprecSe);
+    cv::Mat output;
+    caib::morphCloserec(input, output, dilSe, suprecSe);
+    
+    return output;
+}
+
+/**
+ Apply the mathematical morphology closening by reconstrution operation to a grayscale image,
+ the output can be the input
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param dilSe
+ Structurant element of the dilatation
+ @param suprecSe
+ Structurant element of the superior reconstruction
+ */
+void caib::morphCloserec(const cv::Mat &input, cv::Mat &output, const cv::Mat &dilSe, const cv::Mat &suprecSe) {
+    //the marker is built in the output, the reconstruction works in place over it
+    cv::Mat marker = resultHeader(output, input, false);
+    caib::morphDil(input, marker, dilSe);
+    caib::morphSuprec(marker, input, output, suprecSe);
 }
 
 /**
@@ -312,15 +1686,35 @@ cv::Mat caib::morphCloserec(const cv::Mat &input, const cv::Mat &dilSe, const cv
  @return Ouput grayscale image
  */
 cv::Mat caib::morphClohole(const cv::Mat &input, const cv::Mat &se) {
-    cv::Mat edgeFrame = cv::Mat(input.size(), input.type());
+    cv::Mat output;
+    caib::morphClohole(input, output, se);
+    
+    return output;
+}
+
+/**
+ Apply the mathematical morphology close holes operation to a grayscale image, the
+ output can be the input
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param se
+ Structurant image
+ */
+void caib::morphClohole(const cv::Mat &input, cv::Mat &output, const cv::Mat &se) {
+    CV_Assert( caib::isGray(input) );
     
-    edgeFrame = 255;
-    edgeFrame.col(0).setTo(0);
-    edgeFrame.col(edgeFrame.cols-1).setTo(0);
-    edgeFrame.row(0).setTo(0);
-    edgeFrame.row(edgeFrame.rows-1).setTo(0);
+    //on a binary image the holes are the background not reached from the border
+    if ( caib::isBinary(input) ) {
+        (~borderFlood(~caib::BitMask(input), se)).toMat(output);
+        return;
+    }
+    
+    cv::Mat result = resultHeader(output, input, true);
+    borderReconstruction<eroOrder<uchar> >(input, se, result);
     
-    return caib::morphSuprec(edgeFrame, input);
+    storeResult(result, output);
 }
 
 /**
@@ -331,118 +1725,234 @@ cv::Mat caib::morphClohole(const cv::Mat &input, const cv::Mat &se) {
  Structurant element
  */
 cv::Mat caib::morphRegmax(const cv::Mat &input, const cv::Mat &se) {
-    cv::Mat output = input - caib::morphInfrec((input - 1), input, se);
-    
-    for (int x=0; x<output.cols; x++) {
-        for (int y=0; y<output.rows; y++) {
-            if ( output.at<uchar>(cv::Point(x,y)) > 0 || 255 <= input.at<uchar>(cv::Point(x,y)) )
-                output.at<uchar>(cv::Point(x,y)) = 255;
-            else
-                output.at<uchar>(cv::Point(x,y)) = 0;
+    cv::Mat output;
+    caib::morphRegmax(input, output, se);
+    
+    return output;
+}
+
+/**
+ Find the regional maxima of an input grayscale image, the output can be the input
+ @param input
+ Input grayscaleImage
+ @param output
+ Output binary image, reused if it has the right size and type
+ @param se
+ Structurant element
+ */
+void caib::morphRegmax(const cv::Mat &input, cv::Mat &output, const cv::Mat &se) {
+    CV_Assert( caib::isIntensity(input) );
+    
+    cv::Mat result = resultHeader(output, input, true);
+    depthExtrema<dilOrder>(input, se, result, false);
+    
+    storeResult(result, output);
+}
+
+/**
+ Find the regional minima of an input grayscale image
+ @param input
+ Input grayscaleImage
+ @return se
+ Structurant element
+ */
+cv::Mat caib::morphRegmin(const cv::Mat &input, const cv::Mat &se) {
+    cv::Mat output;
+    caib::morphRegmin(input, output, se);
+    
+    return output;
+}
+
+/**
+ Find the regional minima of an input grayscale image, the output can be the input
+ @param input
+ Input grayscaleImage
+ @param output
+ Output binary image, reused if it has the right size and type
+ @param se
+ Structurant element
+ */
+void caib::morphRegmin(const cv::Mat &input, cv::Mat &output, const cv::Mat &se) {
+    CV_Assert( caib::isIntensity(input) );
+    
+    cv::Mat result = resultHeader(output, input, true);
+    depthExtrema<eroOrder>(input, se, result, false);
+    
+    storeResult(result, output);
+}
+
+/**
+ Find and label the regional maxima of an input grayscale image, to be used as seeds
+ @param input
+ Input grayscale image
+ @param se
+ Structurant element
+ @param numlabels
+ Number of regional maxima found
+ @return Labeled image of the regional maxima
+ */
+cv::Mat caib::morphRegmaxLabel(const cv::Mat &input, const cv::Mat &se, int &numlabels) {
+    cv::Mat output;
+    caib::morphRegmaxLabel(input, output, se, numlabels);
+    
+    return output;
+}
+
+/**
+ Find and label the regional maxima of an input grayscale image, to be used as seeds
+ @param input
+ Input grayscale image
+ @param output
+ Labeled image of the regional maxima, reused if it has the right size and type
+ @param se
+ Structurant element
+ @param numlabels
+ Number of regional maxima found
+ */
+void caib::morphRegmaxLabel(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, int &numlabels) {
+    CV_Assert( caib::isIntensity(input) );
+    
+    cv::Mat result = resultHeader(output, input, true);
+    numlabels = depthExtrema<dilOrder>(input, se, result, true);
+    
+    storeResult(result, output);
+}
+
+/**
+ Find and label the regional minima of an input grayscale image, to be used as seeds
+ @param input
+ Input grayscale image
+ @param se
+ Structurant element
+ @param numlabels
+ Number of regional minima found
+ @return Labeled image of the regional minima
+ */
+cv::Mat caib::morphRegminLabel(const cv::Mat &input, const cv::Mat &se, int &numlabels) {
+    cv::Mat output;
+    caib::morphRegminLabel(input, output, se, numlabels);
+    
+    return output;
+}
+
+/**
+ Find and label the regional minima of an input grayscale image, to be used as seeds
+ @param input
+ Input grayscale image
+ @param output
+ Labeled image of the regional minima, reused if it has the right size and type
+ @param se
+ Structurant element
+ @param numlabels
+ Number of regional minima found
+ */
+void caib::morphRegminLabel(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, int &numlabels) {
+    CV_Assert( caib::isIntensity(input) );
+    
+    cv::Mat result = resultHeader(output, input, true);
+    numlabels = depthExtrema<eroOrder>(input, se, result, true);
+    
+    storeResult(result, output);
+}
+
+//Area opening of a binary image: the components are the outer contours of its regional
+//maxima, the small ones are filled in a mask removed from the result
+cv::Mat binaryAreaopen(const cv::Mat &input, const double &a) {
+    cv::Mat result = caib::morphRegmax(input);
+    
+    std::vector<cv::Vec4i> hierarchy;
+    std::vector<std::vector<cv::Point> > contours;
+    
+    cv::findContours(result.clone(), contours, hierarchy, cv::RETR_CCOMP, cv::CHAIN_APPROX_NONE);
+    cv::Mat temp = cv::Mat::zeros(input.size(), cv::DataType<uchar>::type);
+    
+    for (int c=0; !(c<0) && (c<contours.size()); c=hierarchy[c][0]) {
+        
+        double area = cv::contourArea(contours[c]);
+        
+        if ( area < a ) {
+            cv::drawContours(temp, contours, c, cv::Scalar(255), CV_FILLED, 8, hierarchy);
         }
+        
     }
     
-    return output;
+    result -= temp;
+    
+    return result;
 }
 
 /**
- Find the regional minima of an input grayscale image
+ Apply the morphological area openning on a input grayscale image
  @param input
- Input grayscaleImage
- @return se
+ Input grayscale image
+ @param a
+ Maximum admited area of connected componets
+ @se
  Structurant element
  */
-cv::Mat caib::morphRegmin(const cv::Mat &input, const cv::Mat &se) {
-    cv::Mat output = caib::morphSuprec((input + 1), input, se) - input;
-    
-    for (int x=0; x<output.cols; x++) {
-        for (int y=0; y<output.rows; y++) {
-            if ( output.at<uchar>(cv::Point(x,y)) > 0 || input.at<uchar>(cv::Point(x,y)) <= 0 )
-                output.at<uchar>(cv::Point(x,y)) = 255;
-            else
-                output.at<uchar>(cv::Point(x,y)) = 0;
-        }
-    }
+cv::Mat caib::morphAreaopen(const cv::Mat &input, const double &a) {
+    cv::Mat output;
+    caib::morphAreaopen(input, output, a);
     
     return output;
 }
 
 /**
- Apply the morphological area openning on a input grayscale image
+ Apply the morphological area openning on a input grayscale image, the output can be
+ the input
  @param input
  Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
  @param a
  Maximum admited area of connected componets
- @se
- Structurant element
  */
-cv::Mat caib::morphAreaopen(const cv::Mat &input, const double &a) {
-    cv::Mat output = input.clone();
+void caib::morphAreaopen(const cv::Mat &input, cv::Mat &output, const double &a) {
+    cv::Mat result;
     
     if (caib::isBinary(input)) {
         
-        output = caib::morphRegmax(input);
-
-        std::vector<cv::Vec4i> hierarchy;
-        std::vector<std::vector<cv::Point> > contours;
-        
-        cv::findContours(output.clone(), contours, hierarchy, cv::RETR_CCOMP, cv::CHAIN_APPROX_NONE);
-        cv::Mat temp = cv::Mat::zeros(input.size(), cv::DataType<uchar>::type);
-        
-        for (int c=0; !(c<0) && (c<contours.size()); c=hierarchy[c][0]) {
-            
-            double area = cv::contourArea(contours[c]);
-            
-            if ( area < a ) {
-                cv::drawContours(temp, contours, c, cv::Scalar(255), CV_FILLED, 8, hierarchy);
-            }
-            
-        }
-        
-        output -= temp;
-        
+        result = binaryAreaopen(input, a);
         
     } else {
         
-        std::vector<uchar> values;
-        
-        for (int x=0; x<input.cols; x++) {
-            for (int y=0; y<input.rows; y++) {
-                uchar value = input.data[x + (y * input.cols)];
-                if ( std::find(values.begin(), values.end(), value) == values.end() )
-                    values.push_back(value);
-            }
-        }
-        
-        std::sort(values.begin(), values.end());
-        
-        for (long i = values.size()-1; i > 0; i--) {
-            std::vector<cv::Vec4i> hierarchy;
-            std::vector<std::vector<cv::Point> > contours;
-            cv::Mat layer;
-            
-            
-            cv::threshold(output, layer, values[i]-1, 255,  cv::THRESH_BINARY);
-            cv::findContours(layer.clone(), contours, hierarchy, cv::RETR_CCOMP, cv::CHAIN_APPROX_NONE);
-            
-            for (int c=0; !(c<0) && (c<contours.size()); c=hierarchy[c][0]) {
-                
-                double area = cv::contourArea(contours[c]);
-                
-                if ( area < a ) {
-                    cv::floodFill(output, contours[c][0], values[i-1], 0, 1, 0, 8);
-                }
-                
-            }
-            
-        }
+        result = caib::MaxTree(input).areaFilter(a);
         
     }
     
     
+    storeResult(result, output);
+}
+
+/**
+ Apply the morphological area opening on a input binary image already checked
+ @param input
+ Input binary image
+ @param a
+ Maximum admited area of connected componets
+ @return Output binary image
+ */
+cv::Mat caib::morphAreaopen(const caib::BinaryMat &input, const double &a) {
+    cv::Mat output;
+    caib::morphAreaopen(input, output, a);
+    
     return output;
 }
 
+/**
+ Apply the morphological area opening on a input binary image already checked, the
+ output can be the input
+ @param input
+ Input binary image
+ @param output
+ Output binary image, reused if it has the right size and type
+ @param a
+ Maximum admited area of connected componets
+ */
+void caib::morphAreaopen(const caib::BinaryMat &input, cv::Mat &output, const double &a) {
+    storeResult(binaryAreaopen(input, a), output);
+}
+
 
 /**
  Apply the morphological area closing on a input grayscale image
@@ -454,7 +1964,32 @@ cv::Mat caib::morphAreaopen(const cv::Mat &input, const double &a) {
  Structurant element
  */
 cv::Mat caib::morphAreaclose(const cv::Mat &input, const double &a) {
-    return caib::morphNeg(caib::morphAreaopen(caib::morphNeg(input), a));
+    cv::Mat output;
+    caib::morphAreaclose(input, output, a);
+    
+    return output;
+}
+
+/**
+ Apply the morphological area closing on a input grayscale image, the output can be
+ the input
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param a
+ Maximum admited area of connected componets
+ */
+void caib::morphAreaclose(const cv::Mat &input, cv::Mat &output, const double &a) {
+    if (caib::isBinary(input)) {
+        cv::Mat result;
+        caib::morphNeg(input, result);
+        result = binaryAreaopen(result, a);
+        caib::morphNeg(result, output);
+        return;
+    }
+    
+    storeResult(caib::MaxTree(input, true).areaFilter(a), output);
 }
 
 /**
@@ -466,7 +2001,25 @@ cv::Mat caib::morphAreaclose(const cv::Mat &input, const double &a) {
  @return Ouput grayscale image
  */
 cv::Mat caib::morphOpenth(const cv::Mat &input, const cv::Mat &se) {
-    return input - caib::morphOpen(input, se);
+    cv::Mat output;
+    caib::morphOpenth(input, output, se);
+    
+    return output;
+}
+
+/**
+ Apply the mathematical morphology open top hat operation to a grayscale image, the
+ output can be the input
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param se
+ Structurant image
+ */
+void caib::morphOpenth(const cv::Mat &input, cv::Mat &output, const cv::Mat &se) {
+    caib::MorphExpr f(input);
+    (f - f.open(se)).eval(output);
 }
 
 /**
@@ -478,7 +2031,25 @@ cv::Mat caib::morphOpenth(const cv::Mat &input, const cv::Mat &se) {
  @return Ouput grayscale image
  */
 cv::Mat caib::morphCloseth(const cv::Mat &input, const cv::Mat &se) {
-    return caib::morphClose(input, se) - input;
+    cv::Mat output;
+    caib::morphCloseth(input, output, se);
+    
+    return output;
+}
+
+/**
+ Apply the mathematical morphology close top hat operation to a grayscale image, the
+ output can be the input
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param se
+ Structurant image
+ */
+void caib::morphCloseth(const cv::Mat &input, cv::Mat &output, const cv::Mat &se) {
+    caib::MorphExpr f(input);
+    (f.close(se) - f).eval(output);
 }
 
 /**
@@ -492,7 +2063,30 @@ cv::Mat caib::morphCloseth(const cv::Mat &input, const cv::Mat &se) {
  @return Output grayscale image
  */
 cv::Mat caib::morphOpenrecth(const cv::Mat &input, const cv::Mat &eroSe, const cv::Mat &infrecSe) {
-    return input - caib::morphOpenrec(input, eroSe, infrecSe);
+    cv::Mat output;
+    caib::morphOpenrecth(input, output, eroSe, infrecSe);
+    
+    return output;
+}
+
+/**
+ Apply the mathematical morphology open top hat by reconstruction operation to a grayscale
+ image, the output can be the input
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param eroSe
+ Structurant element of the erosion
+ @param infrecSe
+ Structurant element of the inferior reconstruction
+ */
+void caib::morphOpenrecth(const cv::Mat &input, cv::Mat &output, const cv::Mat &eroSe, const cv::Mat &infrecSe) {
+    cv::Mat result = resultHeader(output, input, false);
+    caib::morphOpenrec(input, result, eroSe, infrecSe);
+    cv::subtract(input, result, result);
+    
+    storeResult(result, output);
 }
 
 /**
@@ -506,7 +2100,30 @@ cv::Mat caib::morphOpenrecth(const cv::Mat &input, const cv::Mat &eroSe, const c
  @return Output grayscale image
  */
 cv::Mat caib::morphCloserecth(const cv::Mat &input, const cv::Mat &dilSe, const cv::Mat &suprecSe) {
-    return caib::morphCloserec(input, dilSe, suprecSe) - input;
+    cv::Mat output;
+    caib::morphCloserecth(input, output, dilSe, suprecSe);
+    
+    return output;
+}
+
+/**
+ Apply the mathematical morphology close top hat by reconstruction operation to a grayscale
+ image, the output can be the input
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param dilSe
+ Structurant element of the dilatation
+ @param suprecSe
+ Structurant element of the superior reconstruction
+ */
+void caib::morphCloserecth(const cv::Mat &input, cv::Mat &output, const cv::Mat &dilSe, const cv::Mat &suprecSe) {
+    cv::Mat result = resultHeader(output, input, false);
+    caib::morphCloserec(input, result, dilSe, suprecSe);
+    cv::subtract(result, input, result);
+    
+    storeResult(result, output);
 }
 
 /**
@@ -518,16 +2135,55 @@ cv::Mat caib::morphCloserecth(const cv::Mat &input, const cv::Mat &dilSe, const
  @return Output binary image
  */
 cv::Mat caib::morphEdgeoff(const cv::Mat &input, const cv::Mat &se) {
-    CV_Assert(caib::isBinary(input));
+    cv::Mat output;
+    caib::morphEdgeoff(input, output, se);
     
-    cv::Mat edgeFrame = cv::Mat::zeros(input.size(), input.type());
-    
-    edgeFrame.col(0).setTo(255);
-    edgeFrame.col(edgeFrame.cols-1).setTo(255);
-    edgeFrame.row(0).setTo(255);
-    edgeFrame.row(edgeFrame.rows-1).setTo(255);
+    return output;
+}
+
+/**
+ Remove all the connected components touching a binary image frame, the output can
+ be the input
+ @param input
+ Input binary image
+ @param output
+ Output binary image, reused if it has the right size and type
+ @param se
+ Structurant element
+ */
+void caib::morphEdgeoff(const cv::Mat &input, cv::Mat &output, const cv::Mat &se) {
+    caib::morphEdgeoff(caib::BinaryMat(input), output, se);
+}
+
+/**
+ Remove all the connected components touching the frame of a binary image already
+ checked
+ @param input
+ Input binary image
+ @param se
+ Structurant element
+ @return Output binary image
+ */
+cv::Mat caib::morphEdgeoff(const caib::BinaryMat &input, const cv::Mat &se) {
+    cv::Mat output;
+    caib::morphEdgeoff(input, output, se);
     
-    return input - caib::morphInfrec( edgeFrame, input, se);
+    return output;
+}
+
+/**
+ Remove all the connected components touching the frame of a binary image already
+ checked, the output can be the input
+ @param binary
+ Input binary image
+ @param output
+ Output binary image, reused if it has the right size and type
+ @param se
+ Structurant element
+ */
+void caib::morphEdgeoff(const caib::BinaryMat &binary, cv::Mat &output, const cv::Mat &se) {
+    caib::BitMask mask(binary.mat());
+    (mask ^ borderFlood(mask, se)).toMat(output);
 }
 
 /**
@@ -541,7 +2197,27 @@ cv::Mat caib::morphEdgeoff(const cv::Mat &input, const cv::Mat &se) {
  @return Output grayscale image
  */
 cv::Mat caib::morphGradm(const cv::Mat &input, const cv::Mat &dilSe, const cv::Mat &eroSe) {
-    return caib::morphDil(input, dilSe) - caib::morphEro(input, eroSe);
+    cv::Mat output;
+    caib::morphGradm(input, output, dilSe, eroSe);
+    
+    return output;
+}
+
+/**
+ Apply the mathematical morphology gradient to a grayscale image, the output can be
+ the input
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param dilSe
+ Structurant element of the dilatation
+ @param eroSe
+ Structurant element of the erosion
+ */
+void caib::morphGradm(const cv::Mat &input, cv::Mat &output, const cv::Mat &dilSe, const cv::Mat &eroSe) {
+    caib::MorphExpr f(input);
+    (f.dil(dilSe) - f.ero(eroSe)).eval(output);
 }
 
 /**
@@ -553,25 +2229,200 @@ cv::Mat caib::morphGradm(const cv::Mat &input, const cv::Mat &dilSe, const cv::M
  @return labeled image
  */
 cv::Mat caib::morphLabel(const cv::Mat &input, const cv::Mat &se) {
-    CV_Assert(caib::isBinary(input));
+    cv::Mat output;
+    int numlabels;
+    caib::morphLabel(input, output, se, numlabels);
+    
+    return output;
+}
+
+/**
+ Label a binary image according to a structurant element
+ @param input
+ Input binary image
+ @param output
+ Labeled image, reused if it has the right size and type
+ @param se
+ Structurant element
+ */
+void caib::morphLabel(const cv::Mat &input, cv::Mat &output, const cv::Mat &se) {
+    int numlabels;
+    caib::morphLabel(input, output, se, numlabels);
+}
+
+/**
+ Label a binary image according to a structurant element. The labels are numbered
+ from 1 following the column-major order of the first pixel of each component
+ @param input
+ Input binary image
+ @param se
+ Structurant element
+ @param numlabels
+ Number of connected components found
+ @return labeled image
+ */
+cv::Mat caib::morphLabel(const cv::Mat &input, const cv::Mat &se, int &numlabels) {
+    cv::Mat output;
+    caib::morphLabel(input, output, se, numlabels);
+    
+    return output;
+}
+
+/**
+ Label a binary image according to a structurant element. The labels are numbered
+ from 1 following the column-major order of the first pixel of each component
+ @param input
+ Input binary image
+ @param output
+ Labeled image, reused if it has the right size and type
+ @param se
+ Structurant element
+ @param numlabels
+ Number of connected components found
+ */
+void caib::morphLabel(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, int &numlabels) {
+    caib::morphLabel(caib::BinaryMat(input), output, se, numlabels);
+}
+
+/**
+ Label a binary image already checked according to a structurant element
+ @param input
+ Input binary image
+ @param se
+ Structurant element
+ @return labeled image
+ */
+cv::Mat caib::morphLabel(const caib::BinaryMat &input, const cv::Mat &se) {
+    cv::Mat output;
+    int numlabels;
+    caib::morphLabel(input, output, se, numlabels);
+    
+    return output;
+}
+
+/**
+ Label a binary image already checked according to a structurant element. The labels
+ are numbered from 1 following the column-major order of the first pixel of each
+ component
+ @param input
+ Input binary image
+ @param se
+ Structurant element
+ @param numlabels
+ Number of connected components found
+ @return labeled image
+ */
+cv::Mat caib::morphLabel(const caib::BinaryMat &input, const cv::Mat &se, int &numlabels) {
+    cv::Mat output;
+    caib::morphLabel(input, output, se, numlabels);
+    
+    return output;
+}
+
+/**
+ Label a binary image already checked according to a structurant element
+ @param input
+ Input binary image
+ @param output
+ Labeled image, reused if it has the right size and type
+ @param se
+ Structurant element
+ */
+void caib::morphLabel(const caib::BinaryMat &input, cv::Mat &output, const cv::Mat &se) {
+    int numlabels;
+    caib::morphLabel(input, output, se, numlabels);
+}
+
+/**
+ Label a binary image already checked according to a structurant element. The labels
+ are numbered from 1 following the column-major order of the first pixel of each
+ component
+ @param binary
+ Input binary image
+ @param output
+ Labeled image, reused if it has the right size and type
+ @param se
+ Structurant element
+ @param numlabels
+ Number of connected components found
+ */
+void caib::morphLabel(const caib::BinaryMat &binary, cv::Mat &output, const cv::Mat &se, int &numlabels) {
+    const cv::Mat &input = binary.mat();
+    cv::Mat image = input.isContinuous() ? input : input.clone();
+    cv::Mat result = resultHeader(output, input, true);
+    result.create(input.size(), cv::DataType<int>::type);
+    result.setTo(cv::Scalar(0));
     
-    cv::Mat temp, output = cv::Mat::zeros(input.size(), cv::DataType<int>::type);
+    //the connectivity is made symmetric, only the neighbours already scanned are kept
+    std::vector<cv::Point> offsets = caib::morphSeoffsets(se), before;
     
-    int label = 1;
+    for (int i = 0; i < offsets.size(); i++) {
+        cv::Point o = offsets[i];
+        if ( !(o.y < 0 || (o.y == 0 && o.x < 0)) )
+            o = cv::Point(-o.x, -o.y);
+        if ( std::find(before.begin(), before.end(), o) == before.end() )
+            before.push_back(o);
+    }
     
-    for (int x=0; x<input.cols; x++) {
-        for (int y=0; y<input.rows; y++) {
-            if ( input.ptr()[x + (y * input.cols)] == 255 && output.ptr<int>()[x + (y *output.cols)] == 0) {
-                temp = cv::Mat::zeros(input.size(), input.type());
-                temp.ptr()[x + (y * temp.cols)] = 255;
-                temp = caib::morphInfrec(temp, input, se);
-                temp.convertTo(temp, cv::DataType<int>::type);
-                
-                output += (temp/255)*(label++);
+    std::vector<int> parent(input.cols * input.rows, -1);
+    
+    int nstrips = std::max(1, std::min(input.rows, cv::getNumThreads() * 4));
+    int stripRows = (input.rows + nstrips - 1) / nstrips;
+    nstrips = (input.rows + stripRows - 1) / stripRows;
+    
+    cv::parallel_for_(cv::Range(0, nstrips), labelStripBody(image, parent, before, stripRows));
+    
+    //merge the components crossing the strips boundaries
+    int cols = input.cols, rows = input.rows;
+    const uchar *in = image.ptr();
+    
+    for (int s = 1; s < nstrips; s++) {
+        int y0 = s * stripRows;
+        
+        for (int i = 0; i < before.size(); i++) {
+            for (int y = y0; y < std::min(rows, y0 - before[i].y); y++) {
+                for (int x = 0; x < cols; x++) {
+                    int nx = x + before[i].x, ny = y + before[i].y;
+                    if ( nx >= 0 && nx < cols && ny >= 0 && in[x + (y * cols)] != 0 && in[nx + (ny * cols)] != 0 )
+                        unionRoots(parent, x + (y * cols), nx + (ny * cols));
+                }
             }
-            
         }
     }
     
-    return output;
+    //flatten the forest and find the first column-major pixel of each component
+    int *out = result.ptr<int>();
+    std::vector<std::pair<int, int> > roots;
+    
+    for (int p = 0; p < cols * rows; p++) {
+        if ( parent[p] < 0 )
+            continue;
+        
+        int r = findRoot(parent, p);
+        parent[p] = r;
+        
+        if ( r == p ) {
+            out[p] = (p % cols) * rows + (p / cols);
+            roots.push_back(std::make_pair(0, p));
+        } else {
+            out[r] = std::min(out[r], (p % cols) * rows + (p / cols));
+        }
+    }
+    
+    for (int i = 0; i < roots.size(); i++)
+        roots[i].first = out[roots[i].second];
+    
+    std::sort(roots.begin(), roots.end());
+    
+    for (int i = 0; i < roots.size(); i++)
+        out[roots[i].second] = i + 1;
+    
+    for (int p = 0; p < cols * rows; p++) {
+        if ( parent[p] >= 0 && parent[p] != p )
+            out[p] = out[parent[p]];
+    }
+    
+    numlabels = (int) roots.size();
+    
+    storeResult(result, output);
 }
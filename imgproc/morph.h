@@ -6,7 +6,9 @@
 //  Copyright (c) 2014 CAIB. All rights reserved.
 //
 //  Note: All the morphological operations bellow that support grayscale images
-//  also support binary images.
+//  also support binary images. The erosions, dilatations, reconstructions, regional
+//  extrema and area filters also work on 16-bit and float grayscale images, the area
+//  filters only on float images without NaN or infinite values.
 //
 //  Name: Rômulo Bourget Novas
 //  Tel: +55 19 99735-7010
@@ -29,49 +31,93 @@ namespace caib {
     
     //Convertions
     CAIB_EXPORTS cv::Mat morphBinary(const cv::Mat &input, const double &r = 1);
+    CAIB_EXPORTS void morphBinary(const cv::Mat &input, cv::Mat &output, const double &r = 1);
     
     //Operations
     CAIB_EXPORTS cv::Mat morphIntersec(const cv::Mat &input1, const cv::Mat &input2);
+    CAIB_EXPORTS void morphIntersec(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output);
     CAIB_EXPORTS cv::Mat morphUnion(const cv::Mat &input1, const cv::Mat &input2);
+    CAIB_EXPORTS void morphUnion(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output);
     CAIB_EXPORTS cv::Mat morphNeg(const cv::Mat &input);
+    CAIB_EXPORTS void morphNeg(const cv::Mat &input, cv::Mat &output);
     CAIB_EXPORTS cv::Mat morphSymdif(const cv::Mat &input1, const cv::Mat &input2);
+    CAIB_EXPORTS void morphSymdif(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output);
 
     //Structuring Elements
     CAIB_EXPORTS cv::Mat morphSebox(const int &size = 1);
     CAIB_EXPORTS cv::Mat morphSecross(const int &size = 1);
     CAIB_EXPORTS cv::Mat morphSedisk(const int &size = 1);
+    CAIB_EXPORTS const cv::Mat &morphSedefault();
+    CAIB_EXPORTS std::vector<cv::Point> morphSeoffsets(const cv::Mat &se);
+    CAIB_EXPORTS std::vector<cv::Vec3i> morphSeruns(const cv::Mat &se);
     
     //Dilatations and Erosions
-    CAIB_EXPORTS cv::Mat morphEro(const cv::Mat &input, const cv::Mat &se = morphSebox());
-    CAIB_EXPORTS cv::Mat morphDil(const cv::Mat &input, const cv::Mat &se = morphSebox());
-    CAIB_EXPORTS cv::Mat morphCero(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se = morphSebox(), const int &n = 1);
-    CAIB_EXPORTS cv::Mat morphCdil(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se = morphSebox(), const int &n = 1);
+    CAIB_EXPORTS cv::Mat morphEro(const cv::Mat &input, const cv::Mat &se = morphSedefault(), const bool &approx = false);
+    CAIB_EXPORTS void morphEro(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const bool &approx = false);
+    CAIB_EXPORTS cv::Mat morphDil(const cv::Mat &input, const cv::Mat &se = morphSedefault(), const bool &approx = false);
+    CAIB_EXPORTS void morphDil(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const bool &approx = false);
+    CAIB_EXPORTS cv::Mat morphCero(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se = morphSedefault(), const int &n = 1, const bool &propagate = false);
+    CAIB_EXPORTS void morphCero(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output, const cv::Mat &se, const int &n = 1, const bool &propagate = false);
+    CAIB_EXPORTS cv::Mat morphCdil(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se = morphSedefault(), const int &n = 1, const bool &propagate = false);
+    CAIB_EXPORTS void morphCdil(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output, const cv::Mat &se, const int &n = 1, const bool &propagate = false);
     
     //Morphological Filters
-    CAIB_EXPORTS cv::Mat morphOpen(const cv::Mat &input, const cv::Mat &se = morphSebox());
-    CAIB_EXPORTS cv::Mat morphClose(const cv::Mat &input, const cv::Mat &se = morphSebox());
+    CAIB_EXPORTS cv::Mat morphOpen(const cv::Mat &input, const cv::Mat &se = morphSedefault(), const bool &approx = false);
+    CAIB_EXPORTS void morphOpen(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const bool &approx = false);
+    CAIB_EXPORTS cv::Mat morphClose(const cv::Mat &input, const cv::Mat &se = morphSedefault(), const bool &approx = false);
+    CAIB_EXPORTS void morphClose(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const bool &approx = false);
     
     //Conected Operators
-    CAIB_EXPORTS cv::Mat morphSuprec(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se = morphSebox());
-    CAIB_EXPORTS cv::Mat morphInfrec(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se = morphSebox());
-    CAIB_EXPORTS cv::Mat morphOpenrec(const cv::Mat &input, const cv::Mat &eroSe = morphSebox(), const cv::Mat &infrecSe = morphSebox());
-    CAIB_EXPORTS cv::Mat morphCloserec(const cv::Mat &input, const cv::Mat &dilSe = morphSebox(), const cv::Mat &supreSe = morphSebox());
-    CAIB_EXPORTS cv::Mat morphClohole(const cv::Mat &input, const cv::Mat &se = morphSebox());
-    CAIB_EXPORTS cv::Mat morphRegmax(const cv::Mat &input, const cv::Mat &se = morphSebox());
-    CAIB_EXPORTS cv::Mat morphRegmin(const cv::Mat &input, const cv::Mat &se = morphSebox());
+    CAIB_EXPORTS cv::Mat morphSuprec(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se = morphSedefault());
+    CAIB_EXPORTS void morphSuprec(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output, const cv::Mat &se);
+    CAIB_EXPORTS cv::Mat morphInfrec(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se = morphSedefault());
+    CAIB_EXPORTS void morphInfrec(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output, const cv::Mat &se);
+    CAIB_EXPORTS cv::Mat morphOpenrec(const cv::Mat &input, const cv::Mat &eroSe = morphSedefault(), const cv::Mat &infrecSe = morphSedefault());
+    CAIB_EXPORTS void morphOpenrec(const cv::Mat &input, cv::Mat &output, const cv::Mat &eroSe, const cv::Mat &infrecSe);
+    CAIB_EXPORTS cv::Mat morphCloserec(const cv::Mat &input, const cv::Mat &dilSe = morphSedefault(), const cv::Mat &supreSe = morphSedefault());
+    CAIB_EXPORTS void morphCloserec(const cv::Mat &input, cv::Mat &output, const cv::Mat &dilSe, const cv::Mat &supreSe);
+    CAIB_EXPORTS cv::Mat morphClohole(const cv::Mat &input, const cv::Mat &se = morphSedefault());
+    CAIB_EXPORTS void morphClohole(const cv::Mat &input, cv::Mat &output, const cv::Mat &se);
+    CAIB_EXPORTS cv::Mat morphRegmax(const cv::Mat &input, const cv::Mat &se = morphSedefault());
+    CAIB_EXPORTS void morphRegmax(const cv::Mat &input, cv::Mat &output, const cv::Mat &se);
+    CAIB_EXPORTS cv::Mat morphRegmin(const cv::Mat &input, const cv::Mat &se = morphSedefault());
+    CAIB_EXPORTS void morphRegmin(const cv::Mat &input, cv::Mat &output, const cv::Mat &se);
+    CAIB_EXPORTS cv::Mat morphRegmaxLabel(const cv::Mat &input, const cv::Mat &se, int &numlabels);
+    CAIB_EXPORTS void morphRegmaxLabel(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, int &numlabels);
+    CAIB_EXPORTS cv::Mat morphRegminLabel(const cv::Mat &input, const cv::Mat &se, int &numlabels);
+    CAIB_EXPORTS void morphRegminLabel(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, int &numlabels);
     CAIB_EXPORTS cv::Mat morphAreaopen(const cv::Mat &input, const double &a);
+    CAIB_EXPORTS void morphAreaopen(const cv::Mat &input, cv::Mat &output, const double &a);
+    CAIB_EXPORTS cv::Mat morphAreaopen(const BinaryMat &input, const double &a);
+    CAIB_EXPORTS void morphAreaopen(const BinaryMat &input, cv::Mat &output, const double &a);
     CAIB_EXPORTS cv::Mat morphAreaclose(const cv::Mat &input, const double &a);
+    CAIB_EXPORTS void morphAreaclose(const cv::Mat &input, cv::Mat &output, const double &a);
     
     //Residues
-    CAIB_EXPORTS cv::Mat morphOpenth(const cv::Mat &input, const cv::Mat &se = morphSebox());
-    CAIB_EXPORTS cv::Mat morphCloseth(const cv::Mat &input, const cv::Mat &se = morphSebox());
-    CAIB_EXPORTS cv::Mat morphOpenrecth(const cv::Mat &input, const cv::Mat &eroSe = morphSebox(), const cv::Mat &infrecSe = morphSebox());
-    CAIB_EXPORTS cv::Mat morphCloserecth(const cv::Mat &input, const cv::Mat &dilSe = morphSebox(), const cv::Mat &supreSe = morphSebox());
-    CAIB_EXPORTS cv::Mat morphEdgeoff( const cv::Mat &input, const cv::Mat &se = morphSebox());
-    CAIB_EXPORTS cv::Mat morphGradm(const cv::Mat &input, const cv::Mat &dilSe = morphSebox(), const cv::Mat &eroSe = morphSebox());
+    CAIB_EXPORTS cv::Mat morphOpenth(const cv::Mat &input, const cv::Mat &se = morphSedefault());
+    CAIB_EXPORTS void morphOpenth(const cv::Mat &input, cv::Mat &output, const cv::Mat &se);
+    CAIB_EXPORTS cv::Mat morphCloseth(const cv::Mat &input, const cv::Mat &se = morphSedefault());
+    CAIB_EXPORTS void morphCloseth(const cv::Mat &input, cv::Mat &output, const cv::Mat &se);
+    CAIB_EXPORTS cv::Mat morphOpenrecth(const cv::Mat &input, const cv::Mat &eroSe = morphSedefault(), const cv::Mat &infrecSe = morphSedefault());
+    CAIB_EXPORTS void morphOpenrecth(const cv::Mat &input, cv::Mat &output, const cv::Mat &eroSe, const cv::Mat &infrecSe);
+    CAIB_EXPORTS cv::Mat morphCloserecth(const cv::Mat &input, const cv::Mat &dilSe = morphSedefault(), const cv::Mat &supreSe = morphSedefault());
+    CAIB_EXPORTS void morphCloserecth(const cv::Mat &input, cv::Mat &output, const cv::Mat &dilSe, const cv::Mat &supreSe);
+    CAIB_EXPORTS cv::Mat morphEdgeoff( const cv::Mat &input, const cv::Mat &se = morphSedefault());
+    CAIB_EXPORTS void morphEdgeoff(const cv::Mat &input, cv::Mat &output, const cv::Mat &se);
+    CAIB_EXPORTS cv::Mat morphEdgeoff(const BinaryMat &input, const cv::Mat &se = morphSedefault());
+    CAIB_EXPORTS void morphEdgeoff(const BinaryMat &input, cv::Mat &output, const cv::Mat &se);
+    CAIB_EXPORTS cv::Mat morphGradm(const cv::Mat &input, const cv::Mat &dilSe = morphSedefault(), const cv::Mat &eroSe = morphSedefault());
+    CAIB_EXPORTS void morphGradm(const cv::Mat &input, cv::Mat &output, const cv::Mat &dilSe, const cv::Mat &eroSe);
     
     //Measurements
-    CAIB_EXPORTS cv::Mat morphLabel(const cv::Mat &input, const cv::Mat &se = morphSebox());
+    CAIB_EXPORTS cv::Mat morphLabel(const cv::Mat &input, const cv::Mat &se = morphSedefault());
+    CAIB_EXPORTS cv::Mat morphLabel(const cv::Mat &input, const cv::Mat &se, int &numlabels);
+    CAIB_EXPORTS void morphLabel(const cv::Mat &input, cv::Mat &output, const cv::Mat &se);
+    CAIB_EXPORTS void morphLabel(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, int &numlabels);
+    CAIB_EXPORTS cv::Mat morphLabel(const BinaryMat &input, const cv::Mat &se = morphSedefault());
+    CAIB_EXPORTS cv::Mat morphLabel(const BinaryMat &input, const cv::Mat &se, int &numlabels);
+    CAIB_EXPORTS void morphLabel(const BinaryMat &input, cv::Mat &output, const cv::Mat &se);
+    CAIB_EXPORTS void morphLabel(const BinaryMat &input, cv::Mat &output, const cv::Mat &se, int &numlabels);
     
 };
 
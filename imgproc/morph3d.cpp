@@ -0,0 +1,913 @@
+//
+//  morph3d.cpp
+//  imgproc
+//
+//  Copyright (c) 2014 CAIB. All rights reserved.
+//
+//  Note: Morphology on volumes, given as continuous 3 dimensional cv::Mat of bytes
+//  indexed by (slice, row, column). The structurant elements are volumes too, with
+//  their anchor in the center. The connectivities 6, 18 and 26 are given by the
+//  structurant elements of morph3dSeconn.
+
+#include "morph3d.h"
+#include "kernels.h"
+
+#include <queue>
+#include <climits>
+
+/**
+ Continuous version of a volume of bytes
+ @param input
+ Input volume
+ @return The input itself when it is continuous, a copy otherwise
+ */
+cv::Mat continuousVolume(const cv::Mat &input) {
+    CV_Assert( input.dims == 3 && input.type() == cv::DataType<uchar>::type );
+
+    return input.isContinuous() ? input : input.clone();
+}
+
+/**
+ Check if two volumes have the same sizes
+ @param input1
+ First volume
+ @param input2
+ Second volume
+ @return TRUE if the sizes are the same
+ */
+bool sameVolume(const cv::Mat &input1, const cv::Mat &input2) {
+    return input1.dims == 3 && input2.dims == 3 && input1.size[0] == input2.size[0] &&
+           input1.size[1] == input2.size[1] && input1.size[2] == input2.size[2];
+}
+
+/**
+ Store a volume into the output volume, reusing the data of the output when it has
+ the right sizes and type
+ @param result
+ Result volume
+ @param output
+ Output volume given by the caller
+ */
+void storeVolume(const cv::Mat &result, cv::Mat &output) {
+    if ( result.data == output.data )
+        return;
+
+    if ( sameVolume(result, output) && output.type() == result.type() )
+        result.copyTo(output);
+    else
+        output = result;
+}
+
+/**
+ Split a structurant element in runs along the columns
+ @param se
+ Structurant element
+ @return Runs given as (first column, last column, row, slice) relative to the anchor
+ */
+std::vector<cv::Vec4i> seRuns3d(const cv::Mat &se) {
+    cv::Mat element = continuousVolume(se);
+    const int depth = element.size[0], rows = element.size[1], cols = element.size[2];
+    const uchar *s = element.ptr();
+    std::vector<cv::Vec4i> runs;
+
+    for (int z = 0; z < depth; z++) {
+        for (int y = 0; y < rows; y++) {
+            const uchar *row = s + ((size_t) z * rows + y) * cols;
+
+            for (int x = 0; x < cols; x++) {
+                if ( row[x] == 0 )
+                    continue;
+
+                int x0 = x;
+                while ( x+1 < cols && row[x+1] != 0 )
+                    x++;
+
+                runs.push_back( cv::Vec4i(x0 - cols/2, x - cols/2, y - rows/2, z - depth/2) );
+            }
+        }
+    }
+
+    return runs;
+}
+
+/**
+ Running erosion (or dilatation) of a sequence of vectors of pixels over a window, with
+ the van Herk/Gil-Werman algorithm applied to whole vectors. The vectors are rows of a
+ slice or of consecutive slices, so the memory is read in contiguous runs
+ @param src
+ First source vector
+ @param dst
+ First destination vector, can be the source
+ @param n
+ Number of vectors
+ @param stride
+ Distance between two consecutive vectors
+ @param len
+ Number of pixels of each vector
+ @param k
+ Size of the window
+ @param anchor
+ Position of the anchor inside the window
+ @param g
+ Buffer for the forward partial results ((n+k-1)*len elements)
+ @param h
+ Buffer for the backward partial results ((n+k-1)*len elements)
+ */
+template <class Order>
+void vhgwVectors(const uchar *src, uchar *dst, const int &n, const size_t &stride, const int &len, const int &k,
+                 const int &anchor, uchar *g, uchar *h) {
+    const int count = n + k - 1;
+
+    for (int j = 0; j < count; j++) {
+        int i = j - anchor;
+        uchar *gj = g + (size_t) j * len;
+        bool first = ( j % k == 0 );
+
+        if ( i < 0 || i >= n ) {
+            if ( first )
+                std::fill(gj, gj + len, Order::identity());
+            else
+                std::copy(gj - len, gj, gj);
+        } else if ( first ) {
+            std::copy(src + i * stride, src + i * stride + len, gj);
+        } else {
+            for (int x = 0; x < len; x++)
+                gj[x] = Order::extend(gj[x - len], src[i * stride + x]);
+        }
+    }
+
+    for (int j = count-1; j >= 0; j--) {
+        int i = j - anchor;
+        uchar *hj = h + (size_t) j * len;
+        bool first = ( j % k == k-1 || j == count-1 );
+
+        if ( i < 0 || i >= n ) {
+            if ( first )
+                std::fill(hj, hj + len, Order::identity());
+            else
+                std::copy(hj + len, hj + 2 * len, hj);
+        } else if ( first ) {
+            std::copy(src + i * stride, src + i * stride + len, hj);
+        } else {
+            for (int x = 0; x < len; x++)
+                hj[x] = Order::extend(hj[x + len], src[i * stride + x]);
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        const uchar *hi = h + (size_t) i * len, *gi = g + (size_t) (i + k - 1) * len;
+        uchar *d = dst + i * stride;
+
+        for (int x = 0; x < len; x++)
+            d[x] = Order::extend(hi[x], gi[x]);
+    }
+}
+
+//Erosion (or dilatation) of a range of slices by a general structurant element, as
+//the union of the runs of the element applied to the rows of the input
+template <class Order>
+class runsSliceBody : public cv::ParallelLoopBody {
+public:
+    runsSliceBody(const cv::Mat &_input, cv::Mat &_output, const std::vector<cv::Vec4i> &_runs)
+    : input(_input), output(&_output), runs(_runs) {}
+
+    void operator()(const cv::Range &range) const {
+        const int depth = input.size[0], rows = input.size[1], cols = input.size[2];
+        const uchar *in = input.ptr();
+        uchar *out = output->ptr();
+        std::vector<uchar> line(cols), g(2*cols + 1), h(2*cols + 1);
+
+        for (int z = range.start; z < range.end; z++) {
+            for (int y = 0; y < rows; y++) {
+                uchar *dst = out + ((size_t) z * rows + y) * cols;
+                std::fill(dst, dst + cols, Order::identity());
+
+                for (int r = 0; r < runs.size(); r++) {
+                    int sz = z + runs[r][3], sy = y + runs[r][2];
+                    if ( sz < 0 || sz >= depth || sy < 0 || sy >= rows )
+                        continue;
+
+                    const uchar *src = in + ((size_t) sz * rows + sy) * cols;
+                    int k = runs[r][1] - runs[r][0] + 1;
+
+                    if ( k == 1 && runs[r][0] == 0 ) {
+                        for (int x = 0; x < cols; x++)
+                            dst[x] = Order::extend(dst[x], src[x]);
+                        continue;
+                    }
+
+                    if ( g.size() < cols + k - 1 ) {
+                        g.resize(cols + k - 1);
+                        h.resize(cols + k - 1);
+                    }
+
+                    vhgwLine<Order>(src, &line[0], cols, k, -runs[r][0], &g[0], &h[0]);
+                    for (int x = 0; x < cols; x++)
+                        dst[x] = Order::extend(dst[x], line[x]);
+                }
+            }
+        }
+    }
+
+private:
+    const cv::Mat &input;
+    cv::Mat *output;
+    const std::vector<cv::Vec4i> &runs;
+};
+
+//Passes along the columns and the rows of a box over a range of slices
+template <class Order>
+class boxSliceBody : public cv::ParallelLoopBody {
+public:
+    boxSliceBody(const cv::Mat &_input, cv::Mat &_output, const cv::Vec3i &_box)
+    : input(_input), output(&_output), box(_box) {}
+
+    void operator()(const cv::Range &range) const {
+        const int rows = input.size[1], cols = input.size[2];
+        const size_t area = (size_t) rows * cols;
+        std::vector<uchar> g( std::max(cols + box[0], (rows + box[1]) * cols) ), h( g.size() );
+
+        for (int z = range.start; z < range.end; z++) {
+            const uchar *src = input.ptr() + z * area;
+            uchar *dst = output->ptr() + z * area;
+
+            if ( box[0] > 1 ) {
+                for (int y = 0; y < rows; y++)
+                    vhgwLine<Order>(src + y * cols, dst + y * cols, cols, box[0], box[0]/2, &g[0], &h[0]);
+            } else if ( src != dst ) {
+                std::copy(src, src + area, dst);
+            }
+
+            if ( box[1] > 1 )
+                vhgwVectors<Order>(dst, dst, rows, cols, cols, box[1], box[1]/2, &g[0], &h[0]);
+        }
+    }
+
+private:
+    const cv::Mat &input;
+    cv::Mat *output;
+    cv::Vec3i box;
+};
+
+//Pass along the slices of a box over a range of rows
+template <class Order>
+class boxRowBody : public cv::ParallelLoopBody {
+public:
+    boxRowBody(cv::Mat &_output, const int &_size)
+    : output(&_output), size(_size) {}
+
+    void operator()(const cv::Range &range) const {
+        const int depth = output->size[0], rows = output->size[1], cols = output->size[2];
+        std::vector<uchar> g( (size_t) (depth + size) * cols ), h( g.size() );
+
+        for (int y = range.start; y < range.end; y++) {
+            uchar *dst = output->ptr() + (size_t) y * cols;
+            vhgwVectors<Order>(dst, dst, depth, (size_t) rows * cols, cols, size, size/2, &g[0], &h[0]);
+        }
+    }
+
+private:
+    cv::Mat *output;
+    int size;
+};
+
+/**
+ Erosion (or dilatation) of a volume. A box is done in three separable passes, the
+ other structurant elements by their runs, both in parallel over the slices
+ @param input
+ Input volume
+ @param output
+ Output volume
+ @param se
+ Structurant element
+ */
+template <class Order>
+void volumeMorph(const cv::Mat &input, cv::Mat &output, const cv::Mat &se) {
+    cv::Mat volume = continuousVolume(input), element = continuousVolume(se);
+    const int depth = volume.size[0], rows = volume.size[1];
+
+    const uchar *s = element.ptr();
+    bool box = ( std::find(s, s + element.total(), 0) == s + element.total() );
+
+    //the passes of a box only read the rows they write, the runs read the neighbour rows
+    cv::Mat result = resultHeader(output, box ? cv::Mat() : volume, true);
+    result.create(3, volume.size.p, cv::DataType<uchar>::type);
+
+    if ( box ) {
+        cv::Vec3i size(element.size[2], element.size[1], element.size[0]);
+        cv::parallel_for_(cv::Range(0, depth), boxSliceBody<Order>(volume, result, size));
+        if ( size[2] > 1 )
+            cv::parallel_for_(cv::Range(0, rows), boxRowBody<Order>(result, size[2]));
+    } else {
+        std::vector<cv::Vec4i> runs = seRuns3d(element);
+        cv::parallel_for_(cv::Range(0, depth), runsSliceBody<Order>(volume, result, runs));
+    }
+
+    storeVolume(result, output);
+}
+
+/**
+ Hybrid reconstruction of a volume, as done in two dimensions: a raster and an
+ anti-raster scan followed by a FIFO propagation of the remaining changes
+ @param marker
+ Continuous marker volume, already limited by the mask. Holds the result at the end
+ @param mask
+ Continuous mask volume
+ @param se
+ Structurant element defining the neighbourhood
+ */
+template <class Order>
+void hybridReconstruction3d(cv::Mat &marker, const cv::Mat &mask, const cv::Mat &se) {
+    std::vector<cv::Point3i> offsets = caib::morph3dSeoffsets(se), before, after;
+
+    for (int i = 0; i < offsets.size(); i++) {
+        const cv::Point3i &o = offsets[i];
+        if ( o.z < 0 || (o.z == 0 && o.y < 0) || (o.z == 0 && o.y == 0 && o.x < 0) )
+            before.push_back(o);
+        else
+            after.push_back(o);
+    }
+
+    const int depth = marker.size[0], rows = marker.size[1], cols = marker.size[2];
+    uchar *J = marker.ptr();
+    const uchar *I = mask.ptr();
+
+    //raster scan
+    for (int z = 0, p = 0; z < depth; z++) {
+        for (int y = 0; y < rows; y++) {
+            for (int x = 0; x < cols; x++, p++) {
+                uchar value = J[p];
+
+                for (int i = 0; i < before.size(); i++) {
+                    int nx = x + before[i].x, ny = y + before[i].y, nz = z + before[i].z;
+                    if ( nx >= 0 && nx < cols && ny >= 0 && ny < rows && nz >= 0 && nz < depth )
+                        value = Order::extend(value, J[nx + (ny + nz * rows) * cols]);
+                }
+
+                J[p] = Order::clip(value, I[p]);
+            }
+        }
+    }
+
+    std::queue<int> fifo;
+
+    //anti-raster scan
+    for (int z = depth-1, p = depth * rows * cols - 1; z >= 0; z--) {
+        for (int y = rows-1; y >= 0; y--) {
+            for (int x = cols-1; x >= 0; x--, p--) {
+                uchar value = J[p];
+
+                for (int i = 0; i < after.size(); i++) {
+                    int nx = x + after[i].x, ny = y + after[i].y, nz = z + after[i].z;
+                    if ( nx >= 0 && nx < cols && ny >= 0 && ny < rows && nz >= 0 && nz < depth )
+                        value = Order::extend(value, J[nx + (ny + nz * rows) * cols]);
+                }
+
+                J[p] = Order::clip(value, I[p]);
+
+                //voxels already scanned that could still be changed by p
+                for (int i = 0; i < before.size(); i++) {
+                    int nx = x - before[i].x, ny = y - before[i].y, nz = z - before[i].z;
+                    if ( nx >= 0 && nx < cols && ny >= 0 && ny < rows && nz >= 0 && nz < depth ) {
+                        int q = nx + (ny + nz * rows) * cols;
+                        if ( Order::below(J[q], J[p]) && J[q] != I[q] ) {
+                            fifo.push(p);
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    //propagation
+    while ( !fifo.empty() ) {
+        int p = fifo.front();
+        fifo.pop();
+
+        int x = p % cols, y = (p / cols) % rows, z = p / (cols * rows);
+
+        for (int i = 0; i < offsets.size(); i++) {
+            int nx = x - offsets[i].x, ny = y - offsets[i].y, nz = z - offsets[i].z;
+            if ( nx >= 0 && nx < cols && ny >= 0 && ny < rows && nz >= 0 && nz < depth ) {
+                int q = nx + (ny + nz * rows) * cols;
+                if ( Order::below(J[q], J[p]) && J[q] != I[q] ) {
+                    J[q] = Order::clip(J[p], I[q]);
+                    fifo.push(q);
+                }
+            }
+        }
+    }
+}
+
+/**
+ Reconstruction of a volume from a marker volume
+ @param input1
+ Marker volume
+ @param input2
+ Mask volume
+ @param output
+ Output volume
+ @param se
+ Structurant element
+ */
+template <class Order>
+void volumeReconstruction(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output, const cv::Mat &se) {
+    cv::Mat marker = continuousVolume(input1), mask = continuousVolume(input2);
+    CV_Assert( sameVolume(marker, mask) );
+
+    //the mask is read during the whole reconstruction
+    if ( sharesData(mask, output) )
+        mask = mask.clone();
+
+    cv::Mat result = resultHeader(output, cv::Mat(), true);
+    result.create(3, marker.size.p, cv::DataType<uchar>::type);
+
+    const uchar *m = marker.ptr(), *I = mask.ptr();
+    uchar *J = result.ptr();
+    for (size_t p = 0; p < marker.total(); p++)
+        J[p] = Order::clip(m[p], I[p]);
+
+    hybridReconstruction3d<Order>(result, mask, se);
+
+    storeVolume(result, output);
+}
+
+/**
+ Offsets of a structurant element made symmetric
+ @param se
+ Structurant element
+ @return Offsets and their opposites, without repetitions
+ */
+std::vector<cv::Point3i> symmetricOffsets3d(const cv::Mat &se) {
+    std::vector<cv::Point3i> offsets = caib::morph3dSeoffsets(se);
+
+    for (int i = (int) offsets.size() - 1; i >= 0; i--) {
+        cv::Point3i o(-offsets[i].x, -offsets[i].y, -offsets[i].z);
+        bool found = false;
+        for (int j = 0; j < offsets.size() && !found; j++)
+            found = ( offsets[j].x == o.x && offsets[j].y == o.y && offsets[j].z == o.z );
+        if ( !found )
+            offsets.push_back(o);
+    }
+
+    return offsets;
+}
+
+//First labelling pass over slabs of slices of a binary volume
+class labelSlabBody : public cv::ParallelLoopBody {
+public:
+    labelSlabBody(const cv::Mat &_input, std::vector<int> &_parent, const std::vector<cv::Point3i> &_before, int _slabSlices)
+    : input(_input), parent(&_parent), before(_before), slabSlices(_slabSlices) {}
+
+    void operator()(const cv::Range &range) const {
+        const int depth = input.size[0], rows = input.size[1], cols = input.size[2];
+        const uchar *in = input.ptr();
+
+        for (int s = range.start; s < range.end; s++) {
+            int z0 = s * slabSlices, z1 = std::min(depth, z0 + slabSlices);
+
+            for (int z = z0; z < z1; z++) {
+                for (int y = 0; y < rows; y++) {
+                    for (int x = 0; x < cols; x++) {
+                        int p = x + (y + z * rows) * cols;
+
+                        if ( in[p] == 0 )
+                            continue;
+
+                        (*parent)[p] = p;
+
+                        for (int i = 0; i < before.size(); i++) {
+                            int nx = x + before[i].x, ny = y + before[i].y, nz = z + before[i].z;
+                            if ( nx >= 0 && nx < cols && ny >= 0 && ny < rows && nz >= z0 ) {
+                                int q = nx + (ny + nz * rows) * cols;
+                                if ( in[q] != 0 )
+                                    unionRoots(*parent, p, q);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    const cv::Mat &input;
+    std::vector<int> *parent;
+    const std::vector<cv::Point3i> &before;
+    int slabSlices;
+};
+
+/**
+ Creates a structurant element with the form of a box
+ @param size
+ The size of the box
+ @return Structurant element
+ */
+cv::Mat caib::morph3dSebox(const int &size) {
+    int sizes[3] = {2*size+1, 2*size+1, 2*size+1};
+
+    return cv::Mat(3, sizes, cv::DataType<uchar>::type, cv::Scalar(1));
+}
+
+/**
+ Creates a structurant element with the form of a ball
+ @param size
+ The radius of the ball
+ @return Structurant element
+ */
+cv::Mat caib::morph3dSeball(const int &size) {
+    int sizes[3] = {2*size+1, 2*size+1, 2*size+1};
+    cv::Mat se = cv::Mat::zeros(3, sizes, cv::DataType<uchar>::type);
+    uchar *s = se.ptr();
+
+    for (int z = -size; z <= size; z++)
+        for (int y = -size; y <= size; y++)
+            for (int x = -size; x <= size; x++, s++)
+                *s = ( x*x + y*y + z*z <= size*size ) ? 1 : 0;
+
+    return se;
+}
+
+/**
+ Creates the structurant element of a connectivity, the voxels sharing a face (6),
+ a face or an edge (18), or a face, an edge or a corner (26) with the anchor
+ @param connectivity
+ Connectivity, 6, 18 or 26
+ @return Structurant element
+ */
+cv::Mat caib::morph3dSeconn(const int &connectivity) {
+    CV_Assert( connectivity == 6 || connectivity == 18 || connectivity == 26 );
+
+    int sizes[3] = {3, 3, 3};
+    int reach = ( connectivity == 6 ) ? 1 : ( connectivity == 18 ) ? 2 : 3;
+    cv::Mat se = cv::Mat::zeros(3, sizes, cv::DataType<uchar>::type);
+    uchar *s = se.ptr();
+
+    for (int z = -1; z <= 1; z++)
+        for (int y = -1; y <= 1; y++)
+            for (int x = -1; x <= 1; x++, s++)
+                *s = ( std::abs(x) + std::abs(y) + std::abs(z) <= reach ) ? 1 : 0;
+
+    return se;
+}
+
+/**
+ Default structurant element of the volume operations, the 26-connectivity. It is
+ built only once
+ @return Structurant element, shared by all the calls
+ */
+const cv::Mat &caib::morph3dSedefault() {
+    static const cv::Mat se = caib::morph3dSeconn(26);
+
+    return se;
+}
+
+/**
+ Get the neighbourhood of a structurant element as offsets relative to its anchor
+ (the anchor itself is not included)
+ @param se
+ Structurant element
+ @return Offsets given as (column, row, slice)
+ */
+std::vector<cv::Point3i> caib::morph3dSeoffsets(const cv::Mat &se) {
+    cv::Mat element = continuousVolume(se);
+    const int depth = element.size[0], rows = element.size[1], cols = element.size[2];
+    const uchar *s = element.ptr();
+    std::vector<cv::Point3i> offsets;
+
+    for (int z = 0; z < depth; z++)
+        for (int y = 0; y < rows; y++)
+            for (int x = 0; x < cols; x++, s++)
+                if ( *s != 0 && (x != cols/2 || y != rows/2 || z != depth/2) )
+                    offsets.push_back( cv::Point3i(x - cols/2, y - rows/2, z - depth/2) );
+
+    return offsets;
+}
+
+/**
+ Apply the mathematical morphology erosion on a volume
+ @param input
+ Input volume
+ @param se
+ Structurant element
+ @return Output volume
+ */
+cv::Mat caib::morph3dEro(const cv::Mat &input, const cv::Mat &se) {
+    cv::Mat output;
+    caib::morph3dEro(input, output, se);
+
+    return output;
+}
+
+/**
+ Apply the mathematical morphology erosion on a volume, the output can be the input
+ @param input
+ Input volume
+ @param output
+ Output volume, reused if it has the right sizes and type
+ @param se
+ Structurant element
+ */
+void caib::morph3dEro(const cv::Mat &input, cv::Mat &output, const cv::Mat &se) {
+    volumeMorph<eroOrder<uchar> >(input, output, se);
+}
+
+/**
+ Apply the mathematical morphology dilatation on a volume
+ @param input
+ Input volume
+ @param se
+ Structurant element
+ @return Output volume
+ */
+cv::Mat caib::morph3dDil(const cv::Mat &input, const cv::Mat &se) {
+    cv::Mat output;
+    caib::morph3dDil(input, output, se);
+
+    return output;
+}
+
+/**
+ Apply the mathematical morphology dilatation on a volume, the output can be the input
+ @param input
+ Input volume
+ @param output
+ Output volume, reused if it has the right sizes and type
+ @param se
+ Structurant element
+ */
+void caib::morph3dDil(const cv::Mat &input, cv::Mat &output, const cv::Mat &se) {
+    volumeMorph<dilOrder<uchar> >(input, output, se);
+}
+
+/**
+ Apply the mathematical morphology superior reconstuction of a volume from another volume
+ @param input1
+ Volume that will be used to recontruct another volume
+ @param input2
+ Volume that will be reconstructed from another volume
+ @param se
+ Structurant element
+ @return Output volume
+ */
+cv::Mat caib::morph3dSuprec(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se) {
+    cv::Mat output;
+    caib::morph3dSuprec(input1, input2, output, se);
+
+    return output;
+}
+
+/**
+ Apply the mathematical morphology superior reconstuction of a volume from another
+ volume, the output can be any of the inputs
+ @param input1
+ Volume that will be used to recontruct another volume
+ @param input2
+ Volume that will be reconstructed from another volume
+ @param output
+ Output volume, reused if it has the right sizes and type
+ @param se
+ Structurant element
+ */
+void caib::morph3dSuprec(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output, const cv::Mat &se) {
+    volumeReconstruction<eroOrder<uchar> >(input1, input2, output, se);
+}
+
+/**
+ Apply the mathematical morphology inferior reconstuction of a volume from another volume
+ @param input1
+ Volume that will be used to recontruct another volume
+ @param input2
+ Volume that will be reconstructed from another volume
+ @param se
+ Structurant element
+ @return Output volume
+ */
+cv::Mat caib::morph3dInfrec(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se) {
+    cv::Mat output;
+    caib::morph3dInfrec(input1, input2, output, se);
+
+    return output;
+}
+
+/**
+ Apply the mathematical morphology inferior reconstuction of a volume from another
+ volume, the output can be any of the inputs
+ @param input1
+ Volume that will be used to recontruct another volume
+ @param input2
+ Volume that will be reconstructed from another volume
+ @param output
+ Output volume, reused if it has the right sizes and type
+ @param se
+ Structurant element
+ */
+void caib::morph3dInfrec(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output, const cv::Mat &se) {
+    volumeReconstruction<dilOrder<uchar> >(input1, input2, output, se);
+}
+
+/**
+ Apply the morphological area openning on a volume
+ @param input
+ Input volume
+ @param a
+ Minimum volume of the connected components kept
+ @param se
+ Structurant element
+ @return Output volume
+ */
+cv::Mat caib::morph3dAreaopen(const cv::Mat &input, const double &a, const cv::Mat &se) {
+    cv::Mat output;
+    caib::morph3dAreaopen(input, output, a, se);
+
+    return output;
+}
+
+/**
+ Apply the morphological area openning on a volume, with the union-find algorithm of
+ A. Meijster and M. H. F. Wilkinson ("A comparison of algorithms for connected set
+ openings and closings", IEEE TPAMI 2002). The voxels are merged from the brightest
+ ones, a component stops growing once it reaches the minimum volume. The output can
+ be the input
+ @param input
+ Input volume
+ @param output
+ Output volume, reused if it has the right sizes and type
+ @param a
+ Minimum volume of the connected components kept
+ @param se
+ Structurant element
+ */
+void caib::morph3dAreaopen(const cv::Mat &input, cv::Mat &output, const double &a, const cv::Mat &se) {
+    cv::Mat volume = continuousVolume(input);
+    const int depth = volume.size[0], rows = volume.size[1], cols = volume.size[2];
+    const int n = depth * rows * cols, lambda = (int) std::min(std::ceil(a), (double) INT_MAX);
+    const uchar *in = volume.ptr();
+
+    std::vector<cv::Point3i> offsets = symmetricOffsets3d(se);
+
+    //voxels sorted by decreasing value, by increasing index inside a value
+    std::vector<int> order(n), start(257, 0);
+    for (int p = 0; p < n; p++)
+        start[255 - in[p] + 1]++;
+    for (int v = 0; v < 256; v++)
+        start[v+1] += start[v];
+    for (int p = 0; p < n; p++)
+        order[ start[255 - in[p]]++ ] = p;
+
+    std::vector<int> parent(n), area(n);
+
+    for (int i = 0; i < n; i++) {
+        int p = order[i];
+        int x = p % cols, y = (p / cols) % rows, z = p / (cols * rows);
+        parent[p] = p;
+        area[p] = 1;
+
+        for (int j = 0; j < offsets.size(); j++) {
+            int nx = x + offsets[j].x, ny = y + offsets[j].y, nz = z + offsets[j].z;
+            if ( nx < 0 || nx >= cols || ny < 0 || ny >= rows || nz < 0 || nz >= depth )
+                continue;
+
+            //only the voxels already processed
+            int q = nx + (ny + nz * rows) * cols;
+            if ( in[q] < in[p] || (in[q] == in[p] && q > p) )
+                continue;
+
+            int r = findRoot(parent, q);
+            if ( r == p )
+                continue;
+
+            if ( in[r] == in[p] || area[r] < lambda ) {
+                parent[r] = p;
+                area[p] += area[r];
+            } else {
+                area[p] = std::max(area[p], lambda);
+            }
+        }
+    }
+
+    cv::Mat result = resultHeader(output, volume, true);
+    result.create(3, volume.size.p, cv::DataType<uchar>::type);
+    uchar *out = result.ptr();
+
+    //the roots keep their value, unless their whole component is too small, the other
+    //voxels take the value of their root
+    for (int i = n-1; i >= 0; i--) {
+        int p = order[i];
+        if ( parent[p] == p )
+            out[p] = ( area[p] >= lambda ) ? in[p] : 0;
+        else
+            out[p] = out[ parent[p] ];
+    }
+
+    storeVolume(result, output);
+}
+
+/**
+ Label a binary volume according to a structurant element
+ @param input
+ Input binary volume
+ @param se
+ Structurant element
+ @return Labeled volume
+ */
+cv::Mat caib::morph3dLabel(const cv::Mat &input, const cv::Mat &se) {
+    cv::Mat output;
+    int numlabels;
+    caib::morph3dLabel(input, output, se, numlabels);
+
+    return output;
+}
+
+/**
+ Label a binary volume according to a structurant element
+ @param input
+ Input binary volume
+ @param se
+ Structurant element
+ @param numlabels
+ Number of connected components found
+ @return Labeled volume
+ */
+cv::Mat caib::morph3dLabel(const cv::Mat &input, const cv::Mat &se, int &numlabels) {
+    cv::Mat output;
+    caib::morph3dLabel(input, output, se, numlabels);
+
+    return output;
+}
+
+/**
+ Label a binary volume according to a structurant element. The components are found
+ in parallel over slabs of slices and merged across the slabs, the labels are numbered
+ from 1 following the raster order of the first voxel of each component
+ @param input
+ Input binary volume
+ @param output
+ Labeled volume, reused if it has the right sizes and type
+ @param se
+ Structurant element
+ @param numlabels
+ Number of connected components found
+ */
+void caib::morph3dLabel(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, int &numlabels) {
+    cv::Mat volume = continuousVolume(input);
+    const int depth = volume.size[0], rows = volume.size[1], cols = volume.size[2];
+    const int n = depth * rows * cols;
+    const uchar *in = volume.ptr();
+
+    //the connectivity is made symmetric, only the neighbours already scanned are kept
+    std::vector<cv::Point3i> offsets = symmetricOffsets3d(se), before;
+    for (int i = 0; i < offsets.size(); i++) {
+        const cv::Point3i &o = offsets[i];
+        if ( o.z < 0 || (o.z == 0 && o.y < 0) || (o.z == 0 && o.y == 0 && o.x < 0) )
+            before.push_back(o);
+    }
+
+    std::vector<int> parent(n, -1);
+
+    int nslabs = std::max(1, std::min(depth, cv::getNumThreads() * 4));
+    int slabSlices = (depth + nslabs - 1) / nslabs;
+    nslabs = (depth + slabSlices - 1) / slabSlices;
+
+    cv::parallel_for_(cv::Range(0, nslabs), labelSlabBody(volume, parent, before, slabSlices));
+
+    //merge the components crossing the slabs boundaries
+    for (int s = 1; s < nslabs; s++) {
+        int z0 = s * slabSlices;
+
+        for (int i = 0; i < before.size(); i++) {
+            for (int z = z0; z < std::min(depth, z0 - before[i].z); z++) {
+                for (int y = 0; y < rows; y++) {
+                    for (int x = 0; x < cols; x++) {
+                        int nx = x + before[i].x, ny = y + before[i].y, nz = z + before[i].z;
+                        if ( nx < 0 || nx >= cols || ny < 0 || ny >= rows || nz < 0 )
+                            continue;
+
+                        int p = x + (y + z * rows) * cols, q = nx + (ny + nz * rows) * cols;
+                        if ( in[p] != 0 && in[q] != 0 )
+                            unionRoots(parent, p, q);
+                    }
+                }
+            }
+        }
+    }
+
+    cv::Mat result = resultHeader(output, volume, true);
+    result.create(3, volume.size.p, cv::DataType<int>::type);
+    int *out = result.ptr<int>();
+
+    //the roots are the first voxels of their components
+    numlabels = 0;
+    for (int p = 0; p < n; p++) {
+        if ( parent[p] < 0 ) {
+            out[p] = 0;
+            continue;
+        }
+
+        int r = findRoot(parent, p);
+        out[p] = ( r == p ) ? ++numlabels : out[r];
+    }
+
+    storeVolume(result, output);
+}
@@ -0,0 +1,53 @@
+//
+//  morph3d.h
+//  imgproc
+//
+//  Copyright (c) 2014 CAIB. All rights reserved.
+//
+//  Note: Morphology on volumes, given as continuous 3 dimensional cv::Mat of bytes
+//  indexed by (slice, row, column). The structurant elements are volumes too, with
+//  their anchor in the center. The connectivities 6, 18 and 26 are given by the
+//  structurant elements of morph3dSeconn.
+
+#ifndef __imgproc__morph3d__
+#define __imgproc__morph3d__
+
+#include <opencv/cv.h>
+#include <opencv/highgui.h>
+
+#include "utilities.h"
+#include "morph.h"
+
+#include <vector>
+
+namespace caib {
+
+    //Structuring Elements
+    CAIB_EXPORTS cv::Mat morph3dSebox(const int &size = 1);
+    CAIB_EXPORTS cv::Mat morph3dSeball(const int &size = 1);
+    CAIB_EXPORTS cv::Mat morph3dSeconn(const int &connectivity = 26);
+    CAIB_EXPORTS const cv::Mat &morph3dSedefault();
+    CAIB_EXPORTS std::vector<cv::Point3i> morph3dSeoffsets(const cv::Mat &se);
+
+    //Dilatations and Erosions
+    CAIB_EXPORTS cv::Mat morph3dEro(const cv::Mat &input, const cv::Mat &se = morph3dSedefault());
+    CAIB_EXPORTS void morph3dEro(const cv::Mat &input, cv::Mat &output, const cv::Mat &se);
+    CAIB_EXPORTS cv::Mat morph3dDil(const cv::Mat &input, const cv::Mat &se = morph3dSedefault());
+    CAIB_EXPORTS void morph3dDil(const cv::Mat &input, cv::Mat &output, const cv::Mat &se);
+
+    //Conected Operators
+    CAIB_EXPORTS cv::Mat morph3dSuprec(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se = morph3dSedefault());
+    CAIB_EXPORTS void morph3dSuprec(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output, const cv::Mat &se);
+    CAIB_EXPORTS cv::Mat morph3dInfrec(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se = morph3dSedefault());
+    CAIB_EXPORTS void morph3dInfrec(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output, const cv::Mat &se);
+    CAIB_EXPORTS cv::Mat morph3dAreaopen(const cv::Mat &input, const double &a, const cv::Mat &se = morph3dSedefault());
+    CAIB_EXPORTS void morph3dAreaopen(const cv::Mat &input, cv::Mat &output, const double &a, const cv::Mat &se);
+
+    //Measurements
+    CAIB_EXPORTS cv::Mat morph3dLabel(const cv::Mat &input, const cv::Mat &se = morph3dSedefault());
+    CAIB_EXPORTS cv::Mat morph3dLabel(const cv::Mat &input, const cv::Mat &se, int &numlabels);
+    CAIB_EXPORTS void morph3dLabel(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, int &numlabels);
+
+};
+
+#endif /* defined(__imgproc__morph3d__) */
@@ -0,0 +1,437 @@
+//
+//  morphexpr.cpp
+//  imgproc
+//
+//  Copyright (c) 2014 CAIB. All rights reserved.
+//
+//  Note: Lazy morphological expressions. The operations are recorded and evaluated
+//  row by row, so the intermediate images only live in small ring buffers.
+
+#include "morphexpr.h"
+#include "kernels.h"
+
+#include <climits>
+
+//Node of an expression prepared for the evaluation, the steps are stored children first
+struct exprStep {
+    const caib::MorphNode *node;
+    cv::Mat image;                  //rows of an input, or of a node evaluated as a whole image
+    int a, b;                       //steps of the operands, -1 if none
+    std::vector<cv::Vec3i> runs;    //runs of the structurant element
+    int lo, hi;                     //rows needed, relative to the output row
+};
+
+void evalNode(const cv::Ptr<caib::MorphNode> &node, cv::Mat &output);
+
+/**
+ Add a node and its operands to the evaluation steps. Erosions and dilatations by tall
+ structurant elements are evaluated as whole images, where they are decomposed, and
+ enter the stream as inputs
+ @param node
+ Node of the expression
+ @param steps
+ Evaluation steps
+ @return Step of the node
+ */
+int flattenExpr(const cv::Ptr<caib::MorphNode> &node, std::vector<exprStep> &steps) {
+    for (int i = 0; i < steps.size(); i++)
+        if ( steps[i].node == node )
+            return i;
+
+    exprStep step;
+    step.node = node;
+    step.a = step.b = -1;
+    step.lo = INT_MAX;
+    step.hi = INT_MIN;
+
+    bool morph = ( node->op == caib::MorphNode::ERO || node->op == caib::MorphNode::DIL );
+
+    if ( node->op == caib::MorphNode::INPUT ) {
+        step.image = node->image;
+    } else if ( morph && node->se.rows >= VHGW_MINSIZE ) {
+        cv::Mat operand;
+        evalNode(node->a, operand);
+
+        if ( node->op == caib::MorphNode::ERO )
+            step.image = caib::morphEro(operand, node->se, node->approx);
+        else
+            step.image = caib::morphDil(operand, node->se, node->approx);
+    } else {
+        step.a = flattenExpr(node->a, steps);
+        if ( !node->b.empty() )
+            step.b = flattenExpr(node->b, steps);
+        if ( morph )
+            step.runs = caib::morphSeruns(node->se);
+    }
+
+    steps.push_back(step);
+    return (int) steps.size() - 1;
+}
+
+//Evaluation of a range of bands of rows, each band streams the rows of every step
+//through a ring buffer holding only the rows still needed by the steps above
+template <class T>
+class exprBandBody : public cv::ParallelLoopBody {
+public:
+    exprBandBody(const std::vector<exprStep> &_steps, cv::Mat &_output, int _bandRows)
+    : steps(_steps), output(&_output), bandRows(_bandRows) {}
+
+    void operator()(const cv::Range &range) const {
+        const int n = (int) steps.size(), cols = output->cols, rows = output->rows;
+
+        std::vector<std::vector<T> > rings(n);
+        std::vector<int> next(n);
+        std::vector<T> line(cols), g(2*cols + 1), h(2*cols + 1);
+
+        for (int band = range.start; band < range.end; band++) {
+            int y0 = band * bandRows, y1 = std::min(rows, y0 + bandRows);
+
+            for (int i = 0; i < n-1; i++) {
+                if ( steps[i].image.empty() )
+                    rings[i].resize( (steps[i].hi - steps[i].lo + 1) * cols );
+                next[i] = std::max(0, y0 + steps[i].lo);
+            }
+
+            for (int y = y0; y < y1; y++) {
+                for (int i = 0; i < n-1; i++) {
+                    if ( !steps[i].image.empty() )
+                        continue;
+
+                    for ( ; next[i] <= std::min(rows-1, y + steps[i].hi); next[i]++)
+                        produceRow(i, next[i], rings, line, g, h);
+                }
+
+                produceRow(n-1, y, rings, line, g, h);
+            }
+        }
+    }
+
+private:
+    const std::vector<exprStep> &steps;
+    cv::Mat *output;
+    int bandRows;
+
+    const T *rowOf(const int &i, const int &y, const std::vector<std::vector<T> > &rings) const {
+        if ( i == (int) steps.size() - 1 )
+            return output->ptr<T>(y);
+        if ( !steps[i].image.empty() )
+            return steps[i].image.ptr<T>(y);
+
+        int cap = steps[i].hi - steps[i].lo + 1;
+        return &rings[i][ (y % cap) * output->cols ];
+    }
+
+    T *dstRow(const int &i, const int &y, std::vector<std::vector<T> > &rings) const {
+        if ( i == (int) steps.size() - 1 )
+            return output->ptr<T>(y);
+
+        int cap = steps[i].hi - steps[i].lo + 1;
+        return &rings[i][ (y % cap) * output->cols ];
+    }
+
+    template <class Order>
+    void morphRow(const exprStep &step, T *dst, const int &y, const std::vector<std::vector<T> > &rings,
+                  std::vector<T> &line, std::vector<T> &g, std::vector<T> &h) const {
+        const int cols = output->cols, rows = output->rows;
+
+        std::fill(dst, dst + cols, Order::identity());
+
+        for (int r = 0; r < step.runs.size(); r++) {
+            int yy = y + step.runs[r][2];
+            if ( yy < 0 || yy >= rows )
+                continue;
+
+            const T *src = rowOf(step.a, yy, rings);
+            int k = step.runs[r][1] - step.runs[r][0] + 1;
+
+            if ( k == 1 && step.runs[r][0] == 0 ) {
+                for (int x = 0; x < cols; x++)
+                    dst[x] = Order::extend(dst[x], src[x]);
+            } else {
+                if ( g.size() < cols + k - 1 ) {
+                    g.resize(cols + k - 1);
+                    h.resize(cols + k - 1);
+                }
+
+                vhgwLine<Order>(src, &line[0], cols, k, -step.runs[r][0], &g[0], &h[0]);
+                for (int x = 0; x < cols; x++)
+                    dst[x] = Order::extend(dst[x], line[x]);
+            }
+        }
+    }
+
+    void produceRow(const int &i, const int &y, std::vector<std::vector<T> > &rings,
+                    std::vector<T> &line, std::vector<T> &g, std::vector<T> &h) const {
+        const exprStep &step = steps[i];
+        const int cols = output->cols;
+        T *dst = dstRow(i, y, rings);
+
+        if ( step.node->op == caib::MorphNode::ERO ) {
+            morphRow<eroOrder<T> >(step, dst, y, rings, line, g, h);
+            return;
+        }
+        if ( step.node->op == caib::MorphNode::DIL ) {
+            morphRow<dilOrder<T> >(step, dst, y, rings, line, g, h);
+            return;
+        }
+
+        const T *a = rowOf(step.a, y, rings);
+        const T *b = ( step.b >= 0 ) ? rowOf(step.b, y, rings) : a;
+
+        switch ( step.node->op ) {
+            case caib::MorphNode::INTERSEC:
+                for (int x = 0; x < cols; x++)
+                    dst[x] = std::min(a[x], b[x]);
+                break;
+            case caib::MorphNode::UNION:
+                for (int x = 0; x < cols; x++)
+                    dst[x] = std::max(a[x], b[x]);
+                break;
+            case caib::MorphNode::SUB:
+                for (int x = 0; x < cols; x++)
+                    dst[x] = ( a[x] > b[x] ) ? a[x] - b[x] : 0;
+                break;
+            case caib::MorphNode::NEG:
+                for (int x = 0; x < cols; x++)
+                    dst[x] = pixelNeg(a[x]);
+                break;
+            default:
+                break;
+        }
+    }
+};
+
+/**
+ Evaluate an expression node, the input nodes return their own image
+ @param node
+ Node of the expression
+ @param output
+ Output grayscale image
+ */
+void evalNode(const cv::Ptr<caib::MorphNode> &node, cv::Mat &output) {
+    std::vector<exprStep> steps;
+    flattenExpr(node, steps);
+
+    exprStep &root = steps.back();
+    if ( !root.image.empty() ) {
+        output = root.image;
+        return;
+    }
+
+    //rows needed by each step, going from the root to the inputs
+    root.lo = root.hi = 0;
+    for (int i = (int) steps.size() - 1; i >= 0; i--) {
+        int reach[2] = {0, 0};
+        for (int r = 0; r < steps[i].runs.size(); r++) {
+            reach[0] = std::min(reach[0], steps[i].runs[r][2]);
+            reach[1] = std::max(reach[1], steps[i].runs[r][2]);
+        }
+
+        int operands[2] = {steps[i].a, steps[i].b};
+        for (int j = 0; j < 2; j++) {
+            if ( operands[j] < 0 )
+                continue;
+            exprStep &op = steps[ operands[j] ];
+            op.lo = std::min(op.lo, steps[i].lo + reach[0]);
+            op.hi = std::max(op.hi, steps[i].hi + reach[1]);
+        }
+    }
+
+    //the output can not be one of the inputs, their rows are read after being written
+    cv::Size size = steps[0].image.size();
+    bool aliased = false;
+    int halo = 0;
+
+    for (int i = 0; i < steps.size(); i++) {
+        if ( !steps[i].image.empty() && !output.empty() && steps[i].image.datastart == output.datastart )
+            aliased = true;
+        halo = std::max(halo, steps[i].hi - steps[i].lo);
+    }
+
+    cv::Mat result = aliased ? cv::Mat() : output;
+    result.create(size, steps[0].image.type());
+
+    int bandRows = std::max(32, 4 * halo);
+    int nbands = (size.height + bandRows - 1) / bandRows;
+
+    switch ( result.depth() ) {
+        case CV_8U:
+            cv::parallel_for_(cv::Range(0, nbands), exprBandBody<uchar>(steps, result, bandRows));
+            break;
+        case CV_16U:
+            cv::parallel_for_(cv::Range(0, nbands), exprBandBody<ushort>(steps, result, bandRows));
+            break;
+        default:
+            cv::parallel_for_(cv::Range(0, nbands), exprBandBody<float>(steps, result, bandRows));
+            break;
+    }
+
+    if ( aliased )
+        result.copyTo(output);
+    else
+        output = result;
+}
+
+/**
+ Create an empty expression
+ */
+caib::MorphExpr::MorphExpr() : tp(-1) {}
+
+/**
+ Create an expression made of a single grayscale image
+ @param input
+ Input grayscale image
+ */
+caib::MorphExpr::MorphExpr(const cv::Mat &input) : sz(input.size()), tp(input.type()) {
+    CV_Assert( caib::isIntensity(input) );
+
+    node = new MorphNode();
+    node->op = MorphNode::INPUT;
+    node->image = input;
+    node->approx = false;
+}
+
+/**
+ Create an expression applying an operation to other expressions
+ @param op
+ Operation
+ @param a
+ First operand
+ @param b
+ Second operand, empty for the operations with a single operand
+ */
+caib::MorphExpr::MorphExpr(const MorphNode::Op &op, const MorphExpr &a, const MorphExpr &b) : sz(a.sz), tp(a.tp) {
+    CV_Assert( !a.empty() && (b.empty() || (a.sz == b.sz && a.tp == b.tp)) );
+
+    node = new MorphNode();
+    node->op = op;
+    node->a = a.node;
+    node->b = b.node;
+    node->approx = false;
+}
+
+/**
+ Erosion of the expression
+ @param se
+ Structurant element
+ @param approx
+ Approximate large disks by octagons
+ @return Expression
+ */
+caib::MorphExpr caib::MorphExpr::ero(const cv::Mat &se, const bool &approx) const {
+    MorphExpr output(MorphNode::ERO, *this, MorphExpr());
+    output.node->se = se;
+    output.node->approx = approx;
+
+    return output;
+}
+
+/**
+ Dilatation of the expression
+ @param se
+ Structurant element
+ @param approx
+ Approximate large disks by octagons
+ @return Expression
+ */
+caib::MorphExpr caib::MorphExpr::dil(const cv::Mat &se, const bool &approx) const {
+    MorphExpr output(MorphNode::DIL, *this, MorphExpr());
+    output.node->se = se;
+    output.node->approx = approx;
+
+    return output;
+}
+
+/**
+ Opening of the expression
+ @param se
+ Structurant element
+ @param approx
+ Approximate large disks by octagons
+ @return Expression
+ */
+caib::MorphExpr caib::MorphExpr::open(const cv::Mat &se, const bool &approx) const {
+    return ero(se, approx).dil(se, approx);
+}
+
+/**
+ Closing of the expression
+ @param se
+ Structurant element
+ @param approx
+ Approximate large disks by octagons
+ @return Expression
+ */
+caib::MorphExpr caib::MorphExpr::close(const cv::Mat &se, const bool &approx) const {
+    return dil(se, approx).ero(se, approx);
+}
+
+/**
+ Intersection of two expressions
+ @param other
+ Expression of the same size
+ @return Expression
+ */
+caib::MorphExpr caib::MorphExpr::intersec(const MorphExpr &other) const {
+    return MorphExpr(MorphNode::INTERSEC, *this, other);
+}
+
+/**
+ Union of two expressions
+ @param other
+ Expression of the same size
+ @return Expression
+ */
+caib::MorphExpr caib::MorphExpr::unite(const MorphExpr &other) const {
+    return MorphExpr(MorphNode::UNION, *this, other);
+}
+
+/**
+ Negative of the expression
+ @return Expression
+ */
+caib::MorphExpr caib::MorphExpr::neg() const {
+    return MorphExpr(MorphNode::NEG, *this, MorphExpr());
+}
+
+/**
+ Saturated difference of two expressions
+ @param other
+ Expression of the same size
+ @return Expression
+ */
+caib::MorphExpr caib::MorphExpr::operator-(const MorphExpr &other) const {
+    return MorphExpr(MorphNode::SUB, *this, other);
+}
+
+/**
+ Evaluate the expression
+ @return Output grayscale image
+ */
+cv::Mat caib::MorphExpr::eval() const {
+    cv::Mat output;
+    eval(output);
+
+    return output;
+}
+
+/**
+ Evaluate the expression into an image, which is reused when it has the right size
+ and type. The image can be one of the inputs of the expression
+ @param output
+ Output grayscale image
+ */
+void caib::MorphExpr::eval(cv::Mat &output) const {
+    CV_Assert( !empty() );
+
+    if ( node->op == MorphNode::INPUT ) {
+        node->image.copyTo(output);
+        return;
+    }
+
+    cv::Mat result = output;
+    evalNode(node, result);
+
+    //a root evaluated as a whole image does not write in the output
+    storeResult(result, output);
+}
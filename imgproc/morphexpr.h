@@ -0,0 +1,68 @@
+//
+//  morphexpr.h
+//  imgproc
+//
+//  Copyright (c) 2014 CAIB. All rights reserved.
+//
+//  Note: Lazy morphological expressions. The operations are recorded and evaluated
+//  row by row, so the intermediate images only live in small ring buffers.
+
+#ifndef __imgproc__morphexpr__
+#define __imgproc__morphexpr__
+
+#include <opencv/cv.h>
+#include <opencv/highgui.h>
+
+#include "utilities.h"
+#include "morph.h"
+
+#include <vector>
+
+namespace caib {
+
+    //Node of a morphological expression
+    struct MorphNode {
+        enum Op { INPUT, ERO, DIL, INTERSEC, UNION, SUB, NEG };
+
+        Op op;
+        cv::Mat image;              //image of the input nodes
+        cv::Mat se;                 //structurant element of the erosions and dilatations
+        bool approx;                //approximate large disks by octagons
+        cv::Ptr<MorphNode> a, b;    //operands
+    };
+
+    //Morphological expression on grayscale images of the same type, evaluated only when asked for
+    class CAIB_EXPORTS MorphExpr {
+    public:
+        MorphExpr();
+        MorphExpr(const cv::Mat &input);
+
+        //Operations
+        MorphExpr ero(const cv::Mat &se = morphSedefault(), const bool &approx = false) const;
+        MorphExpr dil(const cv::Mat &se = morphSedefault(), const bool &approx = false) const;
+        MorphExpr open(const cv::Mat &se = morphSedefault(), const bool &approx = false) const;
+        MorphExpr close(const cv::Mat &se = morphSedefault(), const bool &approx = false) const;
+        MorphExpr intersec(const MorphExpr &other) const;
+        MorphExpr unite(const MorphExpr &other) const;
+        MorphExpr neg() const;
+        MorphExpr operator-(const MorphExpr &other) const;
+
+        //Evaluation
+        cv::Mat eval() const;
+        void eval(cv::Mat &output) const;
+
+        bool empty() const { return node.empty(); }
+        cv::Size size() const { return sz; }
+        int type() const { return tp; }
+
+    private:
+        MorphExpr(const MorphNode::Op &op, const MorphExpr &a, const MorphExpr &b);
+
+        cv::Ptr<MorphNode> node;
+        cv::Size sz;
+        int tp;
+    };
+
+};
+
+#endif /* defined(__imgproc__morphexpr__) */
@@ -21,10 +21,11 @@
 //===========================================================================
 
 #include "slic.h"
+#include "kernels.h"
 
-cv::Mat detectEdges(const std::vector<cv::Mat> &vec, const cv::Size &size) {
+void detectEdges(const std::vector<cv::Mat> &vec, const cv::Size &size, cv::Mat &edges) {
     
-    cv::Mat edges = cv::Mat(size, cv::DataType<double>::type);
+    edges.create(size, cv::DataType<double>::type);
     
     for( int j = 1; j < size.height-1; j++ ) {
         for( int k = 1; k < size.width-1; k++ ) {
@@ -40,8 +41,6 @@ cv::Mat detectEdges(const std::vector<cv::Mat> &vec, const cv::Size &size) {
             edges.ptr<double>()[i] = (dx + dy);
         }
     }
-    
-    return edges;
 }
 
 void perturbSeeds(std::vector<std::vector<double> > &kseeds, std::vector<double> &kseedsx, std::vector<double> &kseedsy, const int &nseeds, const cv::Mat &edges, const std::vector<cv::Mat> &vec, const cv::Size &size) {
@@ -112,7 +111,201 @@ int getSeeds_ForGivenK(std::vector<std::vector<double> > &kseeds, std::vector<do
     return n;
 }
 
-cv::Mat performSuperpixelSegmentation_VariableSandM(std::vector<std::vector<double> > &kseeds, std::vector<double> &kseedsx, std::vector<double> &kseedsy, const std::vector<cv::Mat> &vec, const cv::Size &size, const int &STEP, const int &NUMITR = 10) {
+//Search window of a cluster centre, as the assignment clips it to the image
+cv::Rect slicWindow(const cv::Point2d &centre, const int &offset, const cv::Size &size) {
+    int x1 = std::max(double(0), centre.x-offset);
+    int x2 = std::min(double(size.width), centre.x+offset);
+    int y1 = std::max(double(0), centre.y-offset);
+    int y2 = std::min(double(size.height), centre.y+offset);
+    
+    return cv::Rect(x1, y1, std::max(0, x2 - x1), std::max(0, y2 - y1));
+}
+
+//Active set of the next assignment. A cluster whose centre moved at least the tolerance
+//has its old and new windows cleared, and every cluster whose window meets a cleared area
+//is visited again; the pixels of the other clusters keep their labels and distances. The
+//windows are matched on a grid of cells the size of the offset. Returns the mean movement
+//of the centres
+double slicActiveSet(const std::vector<cv::Point2d> &previous, const std::vector<cv::Point2d> &centres, const double &tolerance, const int &offset, const cv::Size &size, std::vector<cv::Rect> &cleared, std::vector<uchar> &visited) {
+    
+    const int numk = (int) centres.size();
+    cv::Rect frame(0, 0, size.width, size.height);
+    cv::Mat cells = cv::Mat::zeros(size.height/offset + 1, size.width/offset + 1, CV_8U);
+    double error = 0;
+    
+    cleared.assign(numk, cv::Rect());
+    visited.assign(numk, 0);
+    
+    for (int k = 0; k < numk; k++) {
+        double movement = sqrt((centres[k].x - previous[k].x)*(centres[k].x - previous[k].x) + (centres[k].y - previous[k].y)*(centres[k].y - previous[k].y));
+        error += movement;
+        
+        if (movement < tolerance)
+            continue;
+        
+        //one more pixel around, for the rounding of the single precision engine
+        cv::Rect box = slicWindow(previous[k], offset, size) | slicWindow(centres[k], offset, size);
+        box = cv::Rect(box.x - 1, box.y - 1, box.width + 2, box.height + 2) & frame;
+        cleared[k] = box;
+        
+        cells(cv::Range(box.y/offset, (box.y + box.height - 1)/offset + 1), cv::Range(box.x/offset, (box.x + box.width - 1)/offset + 1)) = 1;
+    }
+    
+    for (int k = 0; k < numk; k++) {
+        cv::Rect window = slicWindow(centres[k], offset, size);
+        if (window.area() == 0)
+            continue;
+        
+        for (int cy = window.y/offset; cy <= (window.y + window.height - 1)/offset && !visited[k]; cy++) {
+            for (int cx = window.x/offset; cx <= (window.x + window.width - 1)/offset; cx++) {
+                if (cells.at<uchar>(cy, cx)) {
+                    visited[k] = 1;
+                    break;
+                }
+            }
+        }
+    }
+    
+    return numk ? error/numk : 0;
+}
+
+//Assign the pixels of bands of rows to their nearest seed. In each band the seeds are
+//visited in order, so every pixel sees the same comparisons as in a single loop over the
+//seeds: distc and distxy keep the distances to the last seed visiting the pixel, which
+//the update of maxc and maxxy relies on. The cleared areas of the active set are reset
+//first, then only the visited seeds are assigned
+class slicAssignBody : public cv::ParallelLoopBody {
+public:
+    slicAssignBody(const std::vector<std::vector<double> > &kseeds, const std::vector<double> &kseedsx, const std::vector<double> &kseedsy, const std::vector<cv::Mat> &vec, const std::vector<double> &maxc, const double &invxywt, const int &offset, const int &bandRows, const std::vector<cv::Rect> &cleared, const std::vector<uchar> &visited, std::vector<double> &distc, std::vector<double> &distxy, std::vector<double> &distvec, cv::Mat &klabels)
+    : kseeds(kseeds), kseedsx(kseedsx), kseedsy(kseedsy), vec(vec), maxc(maxc), invxywt(invxywt), offset(offset), bandRows(bandRows), cleared(cleared), visited(visited), distc(&distc), distxy(&distxy), distvec(&distvec), klabels(&klabels) {}
+    
+    void operator()(const cv::Range &range) const {
+        cv::Size size = klabels->size();
+        
+        for (int b = range.start; b < range.end; b++) {
+            int b1 = b*bandRows;
+            int b2 = std::min(size.height, b1 + bandRows);
+            
+            for (int n = 0; n < (int) cleared.size(); n++) {
+                for (int y = std::max(cleared[n].y, b1); y < std::min(cleared[n].y + cleared[n].height, b2); y++) {
+                    std::fill(distvec->begin() + y*size.width + cleared[n].x, distvec->begin() + y*size.width + cleared[n].x + cleared[n].width, DBL_MAX);
+                }
+            }
+            
+            for (int n = 0; n < (int) kseedsx.size(); n++) {
+                if (!visited[n])
+                    continue;
+                
+                int y1 = std::max(double(0), kseedsy[n]-offset);
+                int y2 = std::min(double(size.height), kseedsy[n]+offset);
+                int x1 = std::max(double(0), kseedsx[n]-offset);
+                int x2 = std::min(double(size.width), kseedsx[n]+offset);
+                
+                y1 = std::max(y1, b1);
+                y2 = std::min(y2, b2);
+                
+                for (int y = y1; y < y2; y++) {
+                    for (int x = x1; x < x2; x++) {
+                        int i = y*size.width + x;
+                        
+                        double dc = 0;
+                        for (int c = 0; c < vec.size(); c++) {
+                            dc += (vec[c].ptr<double>()[i] - kseeds[c][n]) * (vec[c].ptr<double>()[i] - kseeds[c][n]);
+                        }
+                        double dxy = (x - kseedsx[n])*(x - kseedsx[n]) + (y - kseedsy[n])*(y - kseedsy[n]);
+                        
+                        (*distc)[i] = dc;
+                        (*distxy)[i] = dxy;
+                        
+                        double dist = dc/maxc[n] + dxy*invxywt;//only varying m, prettier superpixels
+                        
+                        if (dist < (*distvec)[i]) {
+                            (*distvec)[i] = dist;
+                            klabels->ptr<int>()[i] = n;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+private:
+    const std::vector<std::vector<double> > &kseeds;
+    const std::vector<double> &kseedsx, &kseedsy;
+    const std::vector<cv::Mat> &vec;
+    const std::vector<double> &maxc;
+    double invxywt;
+    int offset, bandRows;
+    const std::vector<cv::Rect> &cleared;
+    const std::vector<uchar> &visited;
+    std::vector<double> *distc, *distxy, *distvec;
+    cv::Mat *klabels;
+};
+
+//Sums of the clusters over a band of rows
+struct slicBand {
+    std::vector<int> seeds;     //clusters met in the band, in the order met
+    std::vector<double> sums;   //per cluster: size, x, y, largest distc, largest distxy and the channels
+    bool unlabeled;             //a pixel of the band has no cluster
+};
+
+//Accumulate the cluster sums on bands of rows, each band with its own sums
+class slicUpdateBody : public cv::ParallelLoopBody {
+public:
+    slicUpdateBody(const std::vector<cv::Mat> &vec, const cv::Mat &klabels, const std::vector<double> &distc, const std::vector<double> &distxy, const int &numk, const int &bandRows, std::vector<slicBand> &bands)
+    : vec(vec), klabels(klabels), distc(distc), distxy(distxy), numk(numk), bandRows(bandRows), bands(&bands) {}
+    
+    void operator()(const cv::Range &range) const {
+        int width = klabels.cols, stride = 5 + (int) vec.size();
+        std::vector<int> slot(numk);
+        
+        for (int b = range.start; b < range.end; b++) {
+            slicBand &band = (*bands)[b];
+            band.seeds.clear();
+            band.sums.clear();
+            band.unlabeled = false;
+            std::fill(slot.begin(), slot.end(), -1);
+            
+            int j1 = b*bandRows*width;
+            int j2 = std::min(klabels.rows, (b + 1)*bandRows)*width;
+            
+            for (int j = j1; j < j2; j++) {
+                int k = klabels.ptr<int>()[j];
+                if (!(k >= 0)) {
+                    band.unlabeled = true;
+                    continue;
+                }
+                
+                if (slot[k] < 0) {
+                    slot[k] = (int) band.seeds.size();
+                    band.seeds.push_back(k);
+                    band.sums.resize(band.sums.size() + stride, 0);
+                    band.sums[slot[k]*stride + 3] = distc[j];
+                    band.sums[slot[k]*stride + 4] = distxy[j];
+                }
+                
+                double *sum = &band.sums[slot[k]*stride];
+                sum[0]++;
+                sum[1] += (j%width);
+                sum[2] += (j/width);
+                sum[3] = std::max(sum[3], distc[j]);
+                sum[4] = std::max(sum[4], distxy[j]);
+                for (int c = 0; c < vec.size(); c++) {
+                    sum[5 + c] += vec[c].ptr<double>()[j];
+                }
+            }
+        }
+    }
+    
+private:
+    const std::vector<cv::Mat> &vec;
+    const cv::Mat &klabels;
+    const std::vector<double> &distc, &distxy;
+    int numk, bandRows;
+    std::vector<slicBand> *bands;
+};
+
+void performSuperpixelSegmentation_VariableSandM(std::vector<std::vector<double> > &kseeds, std::vector<double> &kseedsx, std::vector<double> &kseedsy, std::vector<double> &maxc, const std::vector<cv::Mat> &vec, const cv::Size &size, const int &STEP, const int &NUMITR, const double &residual, const double &tolerance, int &iterations, std::vector<double> &distc, std::vector<double> &distxy, std::vector<double> &distvec, cv::Mat &klabels) {
     
     int sz = size.width*size.height;
 	const int numk = (int) kseedsx.size();
@@ -120,7 +313,13 @@ cv::Mat performSuperpixelSegmentation_VariableSandM(std::vector<std::vector<doub
     
 	int offset = (STEP < 10) ? STEP*1.5 : STEP;
     
-    cv::Mat klabels = cv::Mat(size, cv::DataType<int>::type);
+    //the bands depend only on the image, so the sums are added in the same order whatever
+    //the number of threads
+    int bandRows = std::max(STEP, 16);
+    int numbands = (size.height + bandRows - 1) / bandRows;
+    int stride = 5 + (int) vec.size();
+    
+    klabels.create(size, cv::DataType<int>::type);
     klabels = -1;
     
     std::vector<std::vector<double> > sigmac(0);
@@ -131,71 +330,34 @@ cv::Mat performSuperpixelSegmentation_VariableSandM(std::vector<std::vector<doub
     std::vector<double> sigmay(numk, 0);
     std::vector<int> clustersize(numk, 0);
     std::vector<double> inv(numk, 0);//to store 1/clustersize[k] values
-    std::vector<double> distxy(sz, DBL_MAX);
-    std::vector<double> distc(sz, DBL_MAX);
-    std::vector<double> distvec(sz, DBL_MAX);
-    std::vector<double> maxc(numk, 10*10);//THIS IS THE VARIABLE VALUE OF M, just start with 10
+    distxy.assign(sz, DBL_MAX);
+    distc.assign(sz, DBL_MAX);
+    distvec.assign(sz, DBL_MAX);
     std::vector<double> maxxy(numk, STEP*STEP);//THIS IS THE VARIABLE VALUE OF M, just start with 10
     
 	double invxywt = 1.0/(STEP*STEP);//NOTE: this is different from how usual SLIC/LKM works
     
+    //every cluster is visited on the first iteration, on a cleared distvec
+    std::vector<cv::Rect> cleared(numk);
+    std::vector<uchar> visited(numk, 1);
+    std::vector<cv::Point2d> previous(numk), centres(numk);
+    std::vector<slicBand> bands(numbands);
+    
 	while( numitr < NUMITR )
 	{
-		//------
-		//cumerr = 0;
 		numitr++;
-		//------
         
-		distvec.assign(sz, DBL_MAX);
-		for( int n = 0; n < numk; n++ )
-		{
-			int y1 = std::max(double(0), kseedsy[n]-offset);
-			int y2 = std::min(double(size.height),	kseedsy[n]+offset);
-			int x1 = std::max(double(0), kseedsx[n]-offset);
-			int x2 = std::min(double(size.width),	kseedsx[n]+offset);
-            
-			for( int y = y1; y < y2; y++ )
-			{
-				for( int x = x1; x < x2; x++ )
-				{
-					int i = y*size.width + x;
-					if( !(y < size.height && x < size.width && y >= 0 && x >= 0) ) {
-                        throw cv::Exception();
-                    }
-                    
-					distc[i] =	0;
-                    for (int c = 0; c < vec.size(); c++) {
-                        distc[i] += (vec[c].ptr<double>()[i] - kseeds[c][n]) * (vec[c].ptr<double>()[i] - kseeds[c][n]);
-                    }
-                    
-					distxy[i] =		(x - kseedsx[n])*(x - kseedsx[n]) + (y - kseedsy[n])*(y - kseedsy[n]);
-                    
-					double dist = distc[i]/maxc[n] + distxy[i]*invxywt;//only varying m, prettier superpixels
-					
-					if( dist < distvec[i] )
-					{
-						distvec[i] = dist;
-						klabels.ptr<int>()[i]  = n;
-					}
-				}
-			}
-		}
+        cv::parallel_for_(cv::Range(0, numbands), slicAssignBody(kseeds, kseedsx, kseedsy, vec, maxc, invxywt, offset, bandRows, cleared, visited, distc, distxy, distvec, klabels));
+        
 		//-----------------------------------------------------------------
-		// Assign the max color distance for a cluster
+		// Assign the max color distance for a cluster and recalculate the
+		// centroid, each band of rows in its own sums added in band order
 		//-----------------------------------------------------------------
 		if(0 == numitr)
 		{
 			maxc.assign(numk,1);
 			maxxy.assign(numk,1);
 		}
-		{for( int i = 0; i < sz; i++ )
-		{
-			if(maxc[klabels.ptr<int>()[i]] < distc[i]) maxc[klabels.ptr<int>()[i]] = distc[i];
-			if(maxxy[klabels.ptr<int>()[i]] < distxy[i]) maxxy[klabels.ptr<int>()[i]] = distxy[i];
-		}}
-		//-----------------------------------------------------------------
-		// Recalculate the centroid and store in the seed values
-		//-----------------------------------------------------------------
         
         for (int c = 0; c < sigmac.size(); c++) {
             sigmac[c].assign(numk, 0);
@@ -204,19 +366,26 @@ cv::Mat performSuperpixelSegmentation_VariableSandM(std::vector<std::vector<doub
 		sigmay.assign(numk, 0);
 		clustersize.assign(numk, 0);
         
-		for( int j = 0; j < sz; j++ )
-		{
-			if(!(klabels.ptr<int>()[j] >= 0))
+        cv::parallel_for_(cv::Range(0, numbands), slicUpdateBody(vec, klabels, distc, distxy, numk, bandRows, bands));
+        
+        for (int b = 0; b < numbands; b++) {
+            if (bands[b].unlabeled)
                 throw cv::Exception();
             
-            for (int c = 0; c < sigmac.size(); c++) {
-                sigmac[c][klabels.ptr<int>()[j]] += vec[c].ptr<double>()[j];
+            for (int s = 0; s < bands[b].seeds.size(); s++) {
+                int k = bands[b].seeds[s];
+                const double *sum = &bands[b].sums[s*stride];
+                
+                clustersize[k] += (int) sum[0];
+                sigmax[k] += sum[1];
+                sigmay[k] += sum[2];
+                if(maxc[k] < sum[3]) maxc[k] = sum[3];
+                if(maxxy[k] < sum[4]) maxxy[k] = sum[4];
+                for (int c = 0; c < sigmac.size(); c++) {
+                    sigmac[c][k] += sum[5 + c];
+                }
             }
-			sigmax[klabels.ptr<int>()[j]] += (j%size.width);
-			sigmay[klabels.ptr<int>()[j]] += (j/size.width);
-            
-			clustersize[klabels.ptr<int>()[j]]++;
-		}
+        }
         
 		{for( int k = 0; k < numk; k++ )
 		{
@@ -226,18 +395,325 @@ cv::Mat performSuperpixelSegmentation_VariableSandM(std::vector<std::vector<doub
 		
 		{for( int k = 0; k < numk; k++ )
 		{
+            previous[k] = cv::Point2d(kseedsx[k], kseedsy[k]);
             for (int c = 0; c < kseeds.size(); c++) {
                 kseeds[c][k] = sigmac[c][k] * inv[k];
             }
 			kseedsx[k] = sigmax[k]*inv[k];
 			kseedsy[k] = sigmay[k]*inv[k];
+            centres[k] = cv::Point2d(kseedsx[k], kseedsy[k]);
 		}}
+        
+        if (slicActiveSet(previous, centres, tolerance, offset, size, cleared, visited) < residual)
+            break;
 	}
     
-    return klabels;
+    iterations = numitr;
+}
+
+//Squared colour distances between the pixels of a window row and a seed, with the usual
+//channel counts unrolled so the loop is vectorized
+template <class T>
+void colourDistances(const T *row, const float *seed, const int &cn, const int &count, float *out) {
+    if (cn == 3) {
+        for (int x = 0; x < count; x++) {
+            float d0 = row[3*x] - seed[0], d1 = row[3*x + 1] - seed[1], d2 = row[3*x + 2] - seed[2];
+            out[x] = d0*d0 + d1*d1 + d2*d2;
+        }
+    } else if (cn == 1) {
+        for (int x = 0; x < count; x++) {
+            float d0 = row[x] - seed[0];
+            out[x] = d0*d0;
+        }
+    } else {
+        for (int x = 0; x < count; x++) {
+            float d = 0;
+            for (int c = 0; c < cn; c++) {
+                d += (row[cn*x + c] - seed[c]) * (row[cn*x + c] - seed[c]);
+            }
+            out[x] = d;
+        }
+    }
+}
+
+//Single precision assignment on the interleaved pixels of the image. The distances to a
+//seed are computed a window row at a time, and only the best distance, the colour distance
+//to the last seed visiting the pixel and the label of each pixel are kept. The active set
+//is handled as in slicAssignBody
+template <class T>
+class slicAssignFloatBody : public cv::ParallelLoopBody {
+public:
+    slicAssignFloatBody(const cv::Mat &image, const std::vector<float> &seeds, const std::vector<float> &maxc, const float &invxywt, const int &offset, const int &bandRows, const std::vector<cv::Rect> &cleared, const std::vector<uchar> &visited, std::vector<float> &dist, std::vector<float> &distc, cv::Mat &klabels)
+    : image(image), seeds(seeds), maxc(maxc), invxywt(invxywt), offset(offset), bandRows(bandRows), cleared(cleared), visited(visited), dist(&dist), distc(&distc), klabels(&klabels) {}
+    
+    void operator()(const cv::Range &range) const {
+        cv::Size size = image.size();
+        int cn = image.channels(), stride = cn + 2, numk = (int) seeds.size() / stride;
+        std::vector<float> dc(size.width), dd(size.width);
+        
+        for (int b = range.start; b < range.end; b++) {
+            int b1 = b*bandRows;
+            int b2 = std::min(size.height, b1 + bandRows);
+            
+            for (int n = 0; n < (int) cleared.size(); n++) {
+                for (int y = std::max(cleared[n].y, b1); y < std::min(cleared[n].y + cleared[n].height, b2); y++) {
+                    std::fill(dist->begin() + y*size.width + cleared[n].x, dist->begin() + y*size.width + cleared[n].x + cleared[n].width, FLT_MAX);
+                }
+            }
+            
+            for (int n = 0; n < numk; n++) {
+                if (!visited[n])
+                    continue;
+                
+                const float *seed = &seeds[n*stride];
+                float sx = seed[cn], sy = seed[cn + 1], invc = 1.0f/maxc[n];
+                
+                int y1 = std::max(b1, (int) std::max(0.0f, sy - offset));
+                int y2 = std::min(b2, (int) std::min((float) size.height, sy + offset));
+                int x1 = (int) std::max(0.0f, sx - offset);
+                int x2 = (int) std::min((float) size.width, sx + offset);
+                int count = x2 - x1;
+                
+                for (int y = y1; y < y2; y++) {
+                    colourDistances(image.ptr<T>(y) + x1*cn, seed, cn, count, &dc[0]);
+                    
+                    float dy2 = (y - sy)*(y - sy);
+                    for (int x = 0; x < count; x++) {
+                        dd[x] = dc[x]*invc + ((x1 + x - sx)*(x1 + x - sx) + dy2)*invxywt;
+                    }
+                    
+                    float *rowdist = &(*dist)[y*size.width + x1];
+                    float *rowdistc = &(*distc)[y*size.width + x1];
+                    int *rowlabels = klabels->ptr<int>(y) + x1;
+                    
+                    for (int x = 0; x < count; x++) {
+                        bool better = dd[x] < rowdist[x];
+                        rowdist[x] = better ? dd[x] : rowdist[x];
+                        rowdistc[x] = dc[x];
+                        rowlabels[x] = better ? n : rowlabels[x];
+                    }
+                }
+            }
+        }
+    }
+    
+private:
+    const cv::Mat &image;
+    const std::vector<float> &seeds;
+    const std::vector<float> &maxc;
+    float invxywt;
+    int offset, bandRows;
+    const std::vector<cv::Rect> &cleared;
+    const std::vector<uchar> &visited;
+    std::vector<float> *dist, *distc;
+    cv::Mat *klabels;
+};
+
+//Accumulate the cluster sums of the single precision engine on bands of rows, each band
+//with its own sums. A pixel out of every window, as on the margin of a tile, is left out
+template <class T>
+class slicUpdateFloatBody : public cv::ParallelLoopBody {
+public:
+    slicUpdateFloatBody(const cv::Mat &image, const cv::Mat &klabels, const std::vector<float> &distc, const int &numk, const int &bandRows, std::vector<slicBand> &bands)
+    : image(image), klabels(klabels), distc(distc), numk(numk), bandRows(bandRows), bands(&bands) {}
+    
+    void operator()(const cv::Range &range) const {
+        int width = image.cols, cn = image.channels(), stride = 5 + cn;
+        std::vector<int> slot(numk);
+        
+        for (int b = range.start; b < range.end; b++) {
+            slicBand &band = (*bands)[b];
+            band.seeds.clear();
+            band.sums.clear();
+            band.unlabeled = false;
+            std::fill(slot.begin(), slot.end(), -1);
+            
+            for (int y = b*bandRows; y < std::min(image.rows, (b + 1)*bandRows); y++) {
+                const T *row = image.ptr<T>(y);
+                const int *lab = klabels.ptr<int>(y);
+                
+                for (int x = 0; x < width; x++) {
+                    int k = lab[x];
+                    if (k < 0) {
+                        band.unlabeled = true;
+                        continue;
+                    }
+                    
+                    if (slot[k] < 0) {
+                        slot[k] = (int) band.seeds.size();
+                        band.seeds.push_back(k);
+                        band.sums.resize(band.sums.size() + stride, 0);
+                    }
+                    
+                    double *sum = &band.sums[slot[k]*stride];
+                    sum[0]++;
+                    sum[1] += x;
+                    sum[2] += y;
+                    sum[3] = std::max(sum[3], (double) distc[y*width + x]);
+                    for (int c = 0; c < cn; c++) {
+                        sum[5 + c] += row[x*cn + c];
+                    }
+                }
+            }
+        }
+    }
+    
+private:
+    const cv::Mat &image;
+    const cv::Mat &klabels;
+    const std::vector<float> &distc;
+    int numk, bandRows;
+    std::vector<slicBand> *bands;
+};
+
+//Gradient magnitude of the interleaved image at a pixel, the largest value on the frame
+template <class T>
+float pixelEdge(const cv::Mat &image, const int &x, const int &y) {
+    if (x < 1 || y < 1 || x > image.cols - 2 || y > image.rows - 2)
+        return FLT_MAX;
+    
+    int cn = image.channels();
+    const T *up = image.ptr<T>(y - 1) + x*cn, *row = image.ptr<T>(y) + x*cn, *down = image.ptr<T>(y + 1) + x*cn;
+    
+    float e = 0;
+    for (int c = 0; c < cn; c++) {
+        float dx = (float) row[c - cn] - row[c + cn];
+        float dy = (float) up[c] - down[c];
+        e += dx*dx + dy*dy;
+    }
+    
+    return e;
+}
+
+//Points of the hexagonal seed grid of getSeeds_ForGivenK on an image of the given size, row
+//by row
+std::vector<cv::Point> seedGrid(const cv::Size &size, const int &K) {
+    double step = sqrt(double(size.width)*size.height/double(K));
+    int xoff = step/2;
+    int yoff = step/2;
+    
+    std::vector<cv::Point> grid;
+    int r = 0;
+    for (int y = 0; y < size.height; y++) {
+        int Y = y*step + yoff;
+        if (Y > size.height-1) break;
+        
+        for (int x = 0; x < size.width; x++) {
+            int X = x*step + (xoff<<(r&0x1));//hex grid
+            if (X > size.width-1) break;
+            
+            grid.push_back(cv::Point(X, Y));
+        }
+        r++;
+    }
+    
+    return grid;
 }
 
-cv::Mat enforceLabelConnectivity(const cv::Mat &labels, int &numlabels, const cv::Size &size, const int &K) {
+//Seeds of the single precision engine at the points of a grid, moved to the lowest gradient
+//of their neighbourhood, each stored as its channels then x and y
+template <class T>
+void getSeedsFloat(const cv::Mat &image, const std::vector<cv::Point> &grid, std::vector<float> &seeds) {
+    const int dx8[8] = {-1, -1,  0,  1, 1, 1, 0, -1};
+	const int dy8[8] = { 0, -1, -1, -1, 0, 1, 1,  1};
+    
+    cv::Size size = image.size();
+    int cn = image.channels();
+    
+    seeds.clear();
+    for (int n = 0; n < grid.size(); n++) {
+        int X = grid[n].x, Y = grid[n].y;
+        
+        int bx = X, by = Y;
+        float best = pixelEdge<T>(image, X, Y);
+        for (int i = 0; i < 8; i++) {
+            int nx = X + dx8[i], ny = Y + dy8[i];
+            if (nx >= 0 && nx < size.width && ny >= 0 && ny < size.height) {
+                float e = pixelEdge<T>(image, nx, ny);
+                if (e < best) {
+                    best = e;
+                    bx = nx;
+                    by = ny;
+                }
+            }
+        }
+        
+        const T *p = image.ptr<T>(by) + bx*cn;
+        for (int c = 0; c < cn; c++) {
+            seeds.push_back(p[c]);
+        }
+        seeds.push_back(bx);
+        seeds.push_back(by);
+    }
+}
+
+//Single precision SLICO on an interleaved image of bytes, shorts or floats, keeping per
+//pixel only the best distance, a colour distance and the label. The seeds and maxc are
+//carried over from the previous image on a warm start
+template <class T>
+void performSuperpixelSegmentationFloat(const cv::Mat &image, std::vector<float> &seeds, std::vector<float> &maxc, const int &STEP, const int &NUMITR, const double &residual, const double &tolerance, int &iterations, std::vector<float> &dist, std::vector<float> &distc, cv::Mat &klabels) {
+    
+    cv::Size size = image.size();
+    int sz = size.width*size.height, cn = image.channels(), stride = cn + 2;
+    const int numk = (int) seeds.size() / stride;
+    
+    int offset = (STEP < 10) ? STEP*1.5 : STEP;
+    int bandRows = std::max(STEP, 16);
+    int numbands = (size.height + bandRows - 1) / bandRows;
+    
+    klabels.create(size, cv::DataType<int>::type);
+    klabels = -1;
+    
+    dist.assign(sz, FLT_MAX);
+    distc.assign(sz, 0);
+    float invxywt = 1.0f/(STEP*STEP);
+    
+    std::vector<cv::Rect> cleared(numk);
+    std::vector<uchar> visited(numk, 1);
+    std::vector<cv::Point2d> previous(numk), centres(numk);
+    std::vector<slicBand> bands(numbands);
+    
+    iterations = 0;
+    while (iterations < NUMITR) {
+        iterations++;
+        
+        cv::parallel_for_(cv::Range(0, numbands), slicAssignFloatBody<T>(image, seeds, maxc, invxywt, offset, bandRows, cleared, visited, dist, distc, klabels));
+        
+        cv::parallel_for_(cv::Range(0, numbands), slicUpdateFloatBody<T>(image, klabels, distc, numk, bandRows, bands));
+        
+        std::vector<double> sums(numk*(5 + cn), 0);
+        for (int b = 0; b < numbands; b++) {
+            for (int s = 0; s < bands[b].seeds.size(); s++) {
+                int k = bands[b].seeds[s];
+                const double *band = &bands[b].sums[s*(5 + cn)];
+                double *sum = &sums[k*(5 + cn)];
+                
+                for (int c = 0; c < 5 + cn; c++) {
+                    sum[c] = c == 3 ? std::max(sum[c], band[c]) : sum[c] + band[c];
+                }
+            }
+        }
+        
+        for (int k = 0; k < numk; k++) {
+            const double *sum = &sums[k*(5 + cn)];
+            double inv = 1.0/std::max(sum[0], 1.0);
+            
+            previous[k] = cv::Point2d(seeds[k*stride + cn], seeds[k*stride + cn + 1]);
+            maxc[k] = std::max(maxc[k], (float) sum[3]);
+            for (int c = 0; c < cn; c++) {
+                seeds[k*stride + c] = (float) (sum[5 + c]*inv);
+            }
+            seeds[k*stride + cn] = (float) (sum[1]*inv);
+            seeds[k*stride + cn + 1] = (float) (sum[2]*inv);
+            centres[k] = cv::Point2d(seeds[k*stride + cn], seeds[k*stride + cn + 1]);
+        }
+        
+        if (slicActiveSet(previous, centres, tolerance, offset, size, cleared, visited) < residual)
+            break;
+    }
+}
+
+void enforceLabelConnectivity(const cv::Mat &labels, int &numlabels, const cv::Size &size, const int &K, cv::Mat &nlabels, std::vector<int> &xvec, std::vector<int> &yvec) {
     
     const int dx4[4] = {-1,  0,  1,  0};
 	const int dy4[4] = { 0, -1,  0,  1};
@@ -245,12 +721,12 @@ cv::Mat enforceLabelConnectivity(const cv::Mat &labels, int &numlabels, const cv
 	const int sz = size.width*size.height;
 	const int SUPSZ = sz/K;
 	
-    cv::Mat nlabels = cv::Mat(size, cv::DataType<int>::type);
+    nlabels.create(size, cv::DataType<int>::type);
     nlabels = -1;
     
 	int label = 0;
-	int* xvec = new int[sz];
-	int* yvec = new int[sz];
+	xvec.resize(sz);
+	yvec.resize(sz);
 	int oindex = 0;
 	int adjlabel = 0;//adjacent label
     
@@ -322,40 +798,415 @@ cv::Mat enforceLabelConnectivity(const cv::Mat &labels, int &numlabels, const cv
 		}
 	}
 	numlabels = label;
+}
+
+//Root of a part of the superpixels of a tiled segmentation. The root of a group of parts is
+//always its part of lowest index
+int findPart(std::vector<int> &parent, int p) {
+    int r = p;
     
-	if(xvec) delete [] xvec;
-	if(yvec) delete [] yvec;
+    while ( parent[r] != r )
+        r = parent[r];
     
-    return nlabels;
+    while ( parent[p] != r ) {
+        int q = parent[p];
+        parent[p] = r;
+        p = q;
+    }
+    
+    return r;
+}
+
+//Join two parts of the same superpixel that meet on a seam between tiles
+void joinParts(std::vector<int> &parent, std::vector<int64> &area, const int &p, const int &q) {
+    int a = findPart(parent, p);
+    int b = findPart(parent, q);
+    
+    if (a == b)
+        return;
+    if (b < a)
+        std::swap(a, b);
+    
+    parent[b] = a;
+    area[a] += area[b];
+}
+
+//Superpixel of a pixel of a tile in the grid of the whole image, -1 when out of every window
+inline int tileSeed(const cv::Mat &klabels, const std::vector<int> &ids, const int &x, const int &y) {
+    int k = klabels.at<int>(y, x);
+    return k < 0 ? -1 : ids[k];
+}
+
+//Split the superpixels of the core of a tile in 4-connected parts, numbered after the parts
+//of the tiles before and written in output. Each part keeps its superpixel, its area and
+//the part next to its first pixel, found as in enforceLabelConnectivity
+void tileParts(const cv::Mat &klabels, const std::vector<int> &ids, const cv::Point &origin, const cv::Rect &core, cv::Mat &output, std::vector<int> &parent, std::vector<int64> &area, std::vector<int> &adjacent, std::vector<int> &seedOf, int &adjlabel, std::vector<int> &xvec, std::vector<int> &yvec) {
+    
+    const int dx4[4] = {-1,  0,  1,  0};
+	const int dy4[4] = { 0, -1,  0,  1};
+    
+    xvec.resize(core.area());
+    yvec.resize(core.area());
+    
+    for (int j = core.y; j < core.y + core.height; j++) {
+        for (int k = core.x; k < core.x + core.width; k++) {
+            if (output.at<int>(j, k) >= 0)
+                continue;
+            
+            int part = (int) parent.size();
+            int seed = tileSeed(klabels, ids, k - origin.x, j - origin.y);
+            output.at<int>(j, k) = part;
+            
+            for (int n = 0; n < 4; n++) {
+                int x = k + dx4[n];
+                int y = j + dy4[n];
+                if (x >= 0 && x < output.cols && y >= 0 && y < output.rows && output.at<int>(y, x) >= 0)
+                    adjlabel = output.at<int>(y, x);
+            }
+            
+            xvec[0] = k;
+            yvec[0] = j;
+            int count = 1;
+            for (int c = 0; c < count; c++) {
+                for (int n = 0; n < 4; n++) {
+                    int x = xvec[c] + dx4[n];
+                    int y = yvec[c] + dy4[n];
+                    
+                    if (core.contains(cv::Point(x, y)) && output.at<int>(y, x) < 0 && tileSeed(klabels, ids, x - origin.x, y - origin.y) == seed) {
+                        xvec[count] = x;
+                        yvec[count] = y;
+                        output.at<int>(y, x) = part;
+                        count++;
+                    }
+                }
+            }
+            
+            parent.push_back(part);
+            area.push_back(count);
+            adjacent.push_back(adjlabel);
+            seedOf.push_back(seed);
+        }
+    }
 }
 
 cv::Mat caib::slico(const cv::Mat &input, const int& K) {
     
-    std::vector<cv::Mat> vec;
-    cv::Size size;
+    int iterations;
+    
+    return caib::slico(input, K, false, 10, 0, 0, iterations);
+}
+
+/**
+ Segment an image in superpixels with SLICO, choosing the engine
+ @param input
+ Input image
+ @param K
+ Number of superpixels wanted
+ @param lowmem
+ Use the single precision engine, which reads the interleaved pixels of the image as they
+ are and keeps only two distances and a label per pixel, with labels close to the double
+ precision engine for a fraction of its memory
+ @return Labeled image
+ */
+cv::Mat caib::slico(const cv::Mat &input, const int& K, const bool &lowmem) {
+    
+    int iterations;
     
-    int STEP, numlabels;
-    cv::Mat edgemag, labels;
-    cv::vector<double> kseedsx, kseedsy;
-    cv::vector<cv::vector<double> > kseeds;
+    return caib::slico(input, K, lowmem, 10, 0, 0, iterations);
+}
+
+/**
+ Segment an image in superpixels with SLICO, iterating until the clusters settle
+ @param input
+ Input image
+ @param K
+ Number of superpixels wanted
+ @param lowmem
+ Use the single precision engine
+ @param maxiter
+ Largest number of iterations
+ @param residual
+ Stop once the centres moved less than this mean distance, in pixels, in an iteration
+ @param tolerance
+ Clusters whose centre moved less than this distance, in pixels, keep their pixels in the
+ next iteration unless a moving cluster reaches them, and their windows are skipped. With
+ 0 every window is searched on every iteration
+ @param iterations
+ Number of iterations run
+ @return Labeled image
+ */
+cv::Mat caib::slico(const cv::Mat &input, const int& K, const bool &lowmem, const int &maxiter, const double &residual, const double &tolerance, int &iterations) {
+    
+    caib::SlicEngine engine(K, lowmem, maxiter, residual, tolerance);
+    cv::Mat labels = engine.segment(input);
+    
+    iterations = engine.iterations();
+    
+    return labels;
+}
+
+caib::SlicEngine::SlicEngine() : K(0), maxiter(10), lowmem(false), residual(0), tolerance(0), type(-1), numk(0), iters(0) {}
+
+/**
+ Create an engine with its parameters, the workspaces are allocated on the first image
+ @param K
+ Number of superpixels wanted
+ @param lowmem
+ Use the single precision engine
+ @param maxiter
+ Largest number of iterations
+ @param residual
+ Stop once the centres moved less than this mean distance, in pixels, in an iteration
+ @param tolerance
+ Clusters whose centre moved less than this distance, in pixels, have their windows skipped
+ */
+caib::SlicEngine::SlicEngine(const int &K, const bool &lowmem, const int &maxiter, const double &residual, const double &tolerance) : K(K), maxiter(maxiter), lowmem(lowmem), residual(residual), tolerance(tolerance), type(-1), numk(0), iters(0) {
+    CV_Assert(K > 0 && maxiter > 0);
+}
+
+/**
+ Forget the clusters of the previous image, so the next one starts from the seed grid. The
+ workspaces are kept
+ */
+void caib::SlicEngine::reset() {
+    numk = 0;
+    iters = 0;
+}
+
+/**
+ Segment an image in superpixels in a new label image
+ @param input
+ Input image
+ @param warm
+ Start from the clusters of the previous image when it had the same size and type, as
+ for the frames of a sequence, instead of the seed grid
+ @return Labeled image
+ */
+cv::Mat caib::SlicEngine::segment(const cv::Mat &input, const bool &warm) {
+    cv::Mat output;
+    segment(input, output, warm);
+    
+    return output;
+}
+
+/**
+ Segment an image in superpixels, reusing the workspaces of the previous call
+ @param input
+ Input image
+ @param output
+ Labeled image, its data is reused when it already has the size and type of the labels
+ @param warm
+ Start from the clusters of the previous image when it had the same size and type, as
+ for the frames of a sequence, instead of the seed grid
+ */
+void caib::SlicEngine::segment(const cv::Mat &input, cv::Mat &output, const bool &warm) {
+    
+    CV_Assert(K > 0 && !input.empty());
+    
+    bool cold = !warm || numk == 0 || input.size() != size || input.type() != type;
     
     size = input.size();
-    cv::split(input, vec);
+    type = input.type();
+    
+    int STEP = sqrt( double(size.width * size.height) / double(K) ) + 2.0; //adding a small value in case the STEP size is too small.
+    int numlabels;
     
-    for(int c=0; c<input.channels(); c++) {
-        vec[c].convertTo(vec[c], cv::DataType<double>::type);
+    if (!lowmem) {
+        cv::split(input, planes);
+        vec.resize(input.channels());
+        for(int c=0; c<input.channels(); c++) {
+            planes[c].convertTo(vec[c], cv::DataType<double>::type);
+        }
+        
+        if (cold) {
+            kseedsx.clear();
+            kseedsy.clear();
+            kseeds.assign(input.channels(), std::vector<double>());
+            
+            detectEdges(vec, size, edges); //get edges to find better perturb seeds
+            numk = getSeeds_ForGivenK(kseeds, kseedsx, kseedsy, K, edges, vec, size); //get seeds for k
+            maxc.assign(numk, 10*10);//THIS IS THE VARIABLE VALUE OF M, just start with 10
+        }
+        
+        performSuperpixelSegmentation_VariableSandM(kseeds, kseedsx, kseedsy, maxc, vec, size, STEP, maxiter, residual, tolerance, iters, distc, distxy, distvec, klabels); //perform the super pixel segmentation
+    } else {
+        cv::Mat image = input;
+        if (input.depth() != CV_8U && input.depth() != CV_16U && input.depth() != CV_32F) {
+            input.convertTo(converted, CV_MAKETYPE(CV_32F, input.channels()));
+            image = converted;
+        }
+        
+        if (cold) {
+            if (image.depth() == CV_8U)
+                getSeedsFloat<uchar>(image, seedGrid(size, K), seeds);
+            else if (image.depth() == CV_16U)
+                getSeedsFloat<ushort>(image, seedGrid(size, K), seeds);
+            else
+                getSeedsFloat<float>(image, seedGrid(size, K), seeds);
+            
+            numk = (int) seeds.size() / (image.channels() + 2);
+            maxcf.assign(numk, 10*10);//the variable value of m, starting with 10
+        }
+        
+        if (image.depth() == CV_8U)
+            performSuperpixelSegmentationFloat<uchar>(image, seeds, maxcf, STEP, maxiter, residual, tolerance, iters, fdist, fdistc, klabels);
+        else if (image.depth() == CV_16U)
+            performSuperpixelSegmentationFloat<ushort>(image, seeds, maxcf, STEP, maxiter, residual, tolerance, iters, fdist, fdistc, klabels);
+        else
+            performSuperpixelSegmentationFloat<float>(image, seeds, maxcf, STEP, maxiter, residual, tolerance, iters, fdist, fdistc, klabels);
     }
     
-    STEP = sqrt( double(size.width * size.height) / double(K) ) + 2.0; //adding a small value in case the STEP size is too small.
-   
-    kseedsx = std::vector<double>();
-    kseedsy = std::vector<double>();
-    kseeds = std::vector<std::vector<double> >(input.channels(), std::vector<double>() );
+    numlabels = numk;
+    cv::Mat result = resultHeader(output, input, true); //the labels are written by linear index
+    enforceLabelConnectivity(klabels, numlabels, size, K, result, xvec, yvec); //enforce the connectivity of these superpixels
+    
+    storeResult(result, output);
+}
+
+/**
+ Segment a large image in superpixels with SLICO tile by tile. The seeds are placed on one
+ grid over the whole image, each tile is segmented by the single precision engine with a
+ margin of three grid steps around it, and the parts of a superpixel split by a seam are
+ joined before the small parts are merged, so the labels are unique over the image. With
+ a single tile the labels are those of slico with the single precision engine. Only the
+ workspace of the segmentation is bounded by the tile size, the labeled image and the
+ tables of the parts still grow with the image
+ @param input
+ Input image
+ @param K
+ Number of superpixels wanted over the whole image
+ @param tile
+ Size of the tiles
+ @return Labeled image
+ */
+cv::Mat caib::slicoTiled(const cv::Mat &input, const int &K, const cv::Size &tile) {
+    
+    CV_Assert(K > 0 && tile.width > 0 && tile.height > 0 && !input.empty());
     
-    edgemag = detectEdges(vec, size); //get edges to find better perturb seeds
-	numlabels = getSeeds_ForGivenK(kseeds, kseedsx, kseedsy, K, edgemag, vec, size); //get seeds for k
-	labels = performSuperpixelSegmentation_VariableSandM(kseeds, kseedsx, kseedsy, vec, size, STEP); //perform the super pixel segmentation
-    labels = enforceLabelConnectivity(labels, numlabels, size, K); //enforce the connectivity of these superpixels
+    cv::Size size = input.size();
+    cv::Rect frame(0, 0, size.width, size.height);
     
-    return labels;
-}
\ No newline at end of file
+    int STEP = sqrt( double(size.width) * size.height / double(K) ) + 2.0; //adding a small value in case the STEP size is too small.
+    int margin = 3*STEP;
+    const int64 SUPSZ = int64(size.width) * size.height / K;
+    
+    //the grid is made row by row, each row from left to right
+    std::vector<cv::Point> grid = seedGrid(size, K);
+    std::vector<int> rows;
+    for (int n = 0; n < grid.size(); n++) {
+        if (n == 0 || grid[n].y != grid[n-1].y)
+            rows.push_back(n);
+    }
+    rows.push_back((int) grid.size());
+    
+    cv::Mat output(size, cv::DataType<int>::type);
+    output = -1;
+    
+    std::vector<int> parent, adjacent, seedOf;          //per part of a superpixel
+    std::vector<int64> area;
+    std::vector<cv::Point> local;
+    std::vector<int> ids;
+    std::vector<float> seeds, maxc, dist, distc;
+    std::vector<int> xvec, yvec;
+    cv::Mat converted, klabels;
+    int adjlabel = 0, iterations;
+    
+    for (int ty = 0; ty < size.height; ty += tile.height) {
+        for (int tx = 0; tx < size.width; tx += tile.width) {
+            cv::Rect core(tx, ty, std::min(tile.width, size.width - tx), std::min(tile.height, size.height - ty));
+            cv::Rect padded = cv::Rect(core.x - margin, core.y - margin, core.width + 2*margin, core.height + 2*margin) & frame;
+            
+            //seeds of the grid inside the padded tile, in the order of the grid
+            local.clear();
+            ids.clear();
+            for (int r = 0; r + 1 < rows.size(); r++) {
+                int Y = grid[rows[r]].y;
+                if (Y < padded.y || Y >= padded.y + padded.height)
+                    continue;
+                
+                for (int n = rows[r]; n < rows[r+1] && grid[n].x < padded.x + padded.width; n++) {
+                    if (grid[n].x >= padded.x) {
+                        local.push_back(grid[n] - padded.tl());
+                        ids.push_back(n);
+                    }
+                }
+            }
+            
+            cv::Mat image = input(padded);
+            if (input.depth() != CV_8U && input.depth() != CV_16U && input.depth() != CV_32F) {
+                image.convertTo(converted, CV_MAKETYPE(CV_32F, input.channels()));
+                image = converted;
+            }
+            
+            if (image.depth() == CV_8U)
+                getSeedsFloat<uchar>(image, local, seeds);
+            else if (image.depth() == CV_16U)
+                getSeedsFloat<ushort>(image, local, seeds);
+            else
+                getSeedsFloat<float>(image, local, seeds);
+            
+            maxc.assign(local.size(), 10*10);//the variable value of m, starting with 10
+            
+            if (image.depth() == CV_8U)
+                performSuperpixelSegmentationFloat<uchar>(image, seeds, maxc, STEP, 10, 0, 0, iterations, dist, distc, klabels);
+            else if (image.depth() == CV_16U)
+                performSuperpixelSegmentationFloat<ushort>(image, seeds, maxc, STEP, 10, 0, 0, iterations, dist, distc, klabels);
+            else
+                performSuperpixelSegmentationFloat<float>(image, seeds, maxc, STEP, 10, 0, 0, iterations, dist, distc, klabels);
+            
+            tileParts(klabels, ids, padded.tl(), core, output, parent, area, adjacent, seedOf, adjlabel, xvec, yvec);
+            
+            //stitch the parts of the same superpixel across the left and top seams
+            for (int y = core.y; y < core.y + core.height && core.x > 0; y++) {
+                int p = output.at<int>(y, core.x - 1), q = output.at<int>(y, core.x);
+                if (seedOf[p] == seedOf[q])
+                    joinParts(parent, area, p, q);
+            }
+            for (int x = core.x; x < core.x + core.width && core.y > 0; x++) {
+                int p = output.at<int>(core.y - 1, x), q = output.at<int>(core.y, x);
+                if (seedOf[p] == seedOf[q])
+                    joinParts(parent, area, p, q);
+            }
+        }
+    }
+    
+    //merge the superpixels too small into the part found next to their first pixel, then
+    //number the superpixels in the order they were met
+    const int numparts = (int) parent.size();
+    
+    for (int p = 0; p < numparts; p++) {
+        if (findPart(parent, p) == p && area[p] <= SUPSZ >> 2) {
+            int a = findPart(parent, adjacent[p]);
+            if (a != p)
+                parent[p] = a;
+        }
+    }
+    
+    //the first part has no neighbour met before it, when too small it takes the label of
+    //the next superpixel kept, as enforceLabelConnectivity gives its label to that one
+    if (numparts > 0 && findPart(parent, 0) == 0 && area[0] <= SUPSZ >> 2) {
+        int q = 1;
+        while (q < numparts && findPart(parent, q) != q)
+            q++;
+        if (q < numparts)
+            parent[0] = q;
+    }
+    
+    std::vector<int> lut(numparts, -1);
+    int numlabels = 0;
+    for (int p = 0; p < numparts; p++) {
+        int r = findPart(parent, p);
+        if (lut[r] < 0)
+            lut[r] = numlabels++;
+        lut[p] = lut[r];
+    }
+    
+    for (int y = 0; y < size.height; y++) {
+        int *row = output.ptr<int>(y);
+        for (int x = 0; x < size.width; x++) {
+            row[x] = lut[row[x]];
+        }
+    }
+    
+    return output;
+}
@@ -38,7 +38,44 @@
 
 namespace caib {
     
+    //SLICO superpixels that keep their workspaces between calls on images of the same size
+    //and type, and can start from the clusters of the previous image of a sequence
+    class CAIB_EXPORTS SlicEngine {
+    public:
+        SlicEngine();
+        SlicEngine(const int &K, const bool &lowmem = false, const int &maxiter = 10, const double &residual = 0, const double &tolerance = 0);
+        
+        cv::Mat segment(const cv::Mat &input, const bool &warm = false);
+        void segment(const cv::Mat &input, cv::Mat &output, const bool &warm = false);
+        void reset();
+        
+        bool empty() const { return numk == 0; }
+        int clusters() const { return numk; }
+        int iterations() const { return iters; }
+        
+    private:
+        int K, maxiter;
+        bool lowmem;
+        double residual, tolerance;
+        
+        cv::Size size;
+        int type;                                   //type of the image the clusters come from
+        int numk, iters;
+        
+        std::vector<cv::Mat> planes, vec;           //channels of the image, and in double for the double engine
+        cv::Mat edges, converted, klabels;          //converted is the image in float for the single precision engine
+        std::vector<std::vector<double> > kseeds;   //clusters of the double engine
+        std::vector<double> kseedsx, kseedsy, maxc;
+        std::vector<double> distc, distxy, distvec;
+        std::vector<float> seeds, maxcf;            //clusters of the single precision engine, channels then x and y
+        std::vector<float> fdist, fdistc;
+        std::vector<int> xvec, yvec;                //segment grown by the connectivity pass
+    };
+    
     CAIB_EXPORTS cv::Mat slico(const cv::Mat &input, const int& K);
+    CAIB_EXPORTS cv::Mat slico(const cv::Mat &input, const int& K, const bool &lowmem);
+    CAIB_EXPORTS cv::Mat slico(const cv::Mat &input, const int& K, const bool &lowmem, const int &maxiter, const double &residual, const double &tolerance, int &iterations);
+    CAIB_EXPORTS cv::Mat slicoTiled(const cv::Mat &input, const int &K, const cv::Size &tile = cv::Size(1024, 1024));
     
 };
 
@@ -0,0 +1,497 @@
+//
+//  tiled.cpp
+//  imgproc
+//
+//  Copyright (c) 2014 CAIB. All rights reserved.
+//
+//  Note: Morphology on large images split in tiles processed in parallel. Each tile
+//  is read with a halo sized from the structurant element, so the local operations
+//  give the same result as on the whole image. The reconstructions exchange the
+//  borders of the tiles until no value propagates from a tile to another.
+
+#include "tiled.h"
+#include "kernels.h"
+
+//Local operations applied to the tiles
+enum tileOp { TILE_ERO, TILE_DIL, TILE_OPEN, TILE_CLOSE };
+
+/**
+ Reach of a structurant element, the largest horizontal and vertical distances
+ between its anchor and its pixels
+ @param se
+ Structurant element
+ @return Reach of the structurant element
+ */
+cv::Size seReach(const cv::Mat &se) {
+    std::vector<cv::Point> offsets = caib::morphSeoffsets(se);
+    cv::Size reach(0, 0);
+
+    for (int i = 0; i < offsets.size(); i++) {
+        reach.width = std::max(reach.width, std::abs(offsets[i].x));
+        reach.height = std::max(reach.height, std::abs(offsets[i].y));
+    }
+
+    return reach;
+}
+
+/**
+ Split an image in tiles, row by row. The last tiles of each row and column are
+ smaller when the image size is not a multiple of the tile size
+ @param size
+ Size of the image
+ @param tile
+ Size of the tiles
+ @return Tiles
+ */
+std::vector<cv::Rect> splitTiles(const cv::Size &size, const cv::Size &tile) {
+    std::vector<cv::Rect> tiles;
+
+    for (int y = 0; y < size.height; y += tile.height)
+        for (int x = 0; x < size.width; x += tile.width)
+            tiles.push_back( cv::Rect(x, y, std::min(tile.width, size.width - x), std::min(tile.height, size.height - y)) );
+
+    return tiles;
+}
+
+/**
+ Tile extended by a halo, clipped to the image
+ @param tile
+ Tile
+ @param halo
+ Width and height of the halo
+ @param size
+ Size of the image
+ @return Extended tile
+ */
+cv::Rect haloRect(const cv::Rect &tile, const cv::Size &halo, const cv::Size &size) {
+    int x0 = std::max(0, tile.x - halo.width), y0 = std::max(0, tile.y - halo.height);
+    int x1 = std::min(size.width, tile.x + tile.width + halo.width), y1 = std::min(size.height, tile.y + tile.height + halo.height);
+
+    return cv::Rect(x0, y0, x1 - x0, y1 - y0);
+}
+
+/**
+ Check if the pixels of two images differ in a frame along their borders
+ @param input1
+ First image
+ @param input2
+ Second image of the same size
+ @param frame
+ Width and height of the frame
+ @return TRUE if a pixel of the frame differs
+ */
+bool frameChanged(const cv::Mat &input1, const cv::Mat &input2, const cv::Size &frame) {
+    const int cols = input1.cols, rows = input1.rows;
+
+    for (int y = 0; y < rows; y++) {
+        const uchar *a = input1.ptr(y), *b = input2.ptr(y);
+        bool full = ( y < frame.height || y >= rows - frame.height || 2 * frame.width >= cols );
+
+        for (int x = 0; x < cols; x++) {
+            if ( !full && x == frame.width )
+                x = cols - frame.width;
+            if ( a[x] != b[x] )
+                return true;
+        }
+    }
+
+    return false;
+}
+
+//Local operation over a range of tiles, each tile is computed on its extended
+//area and only its own pixels are written in the output
+class tileMorphBody : public cv::ParallelLoopBody {
+public:
+    tileMorphBody(const cv::Mat &_input, cv::Mat &_output, const cv::Mat &_se, const std::vector<cv::Rect> &_tiles,
+                  const cv::Size &_halo, tileOp _op)
+    : input(_input), output(&_output), se(_se), tiles(_tiles), halo(_halo), op(_op) {}
+
+    void operator()(const cv::Range &range) const {
+        cv::Mat result;
+
+        for (int t = range.start; t < range.end; t++) {
+            cv::Rect ext = haloRect(tiles[t], halo, input.size());
+            cv::Mat roi = input(ext);
+
+            switch ( op ) {
+                case TILE_ERO:
+                    caib::morphEro(roi, result, se);
+                    break;
+                case TILE_DIL:
+                    caib::morphDil(roi, result, se);
+                    break;
+                case TILE_OPEN:
+                    caib::morphOpen(roi, result, se);
+                    break;
+                case TILE_CLOSE:
+                    caib::morphClose(roi, result, se);
+                    break;
+            }
+
+            cv::Mat core = (*output)(tiles[t]);
+            result(cv::Rect(tiles[t].tl() - ext.tl(), tiles[t].size())).copyTo(core);
+        }
+    }
+
+private:
+    const cv::Mat &input;
+    cv::Mat *output;
+    const cv::Mat &se;
+    const std::vector<cv::Rect> &tiles;
+    cv::Size halo;
+    tileOp op;
+};
+
+//Reconstruction over a list of tiles of the same colour. Each tile is reconstructed
+//on its extended area, the halo holding the current values of the neighbour tiles,
+//and the tiles whose frame changed are reported so their neighbours are done again
+class tileRecBody : public cv::ParallelLoopBody {
+public:
+    tileRecBody(const cv::Mat &_mask, cv::Mat &_output, const cv::Mat &_se, const std::vector<cv::Rect> &_tiles,
+                const std::vector<int> &_active, const cv::Size &_halo, bool _superior, std::vector<uchar> &_changed)
+    : mask(_mask), output(&_output), se(_se), tiles(_tiles), active(_active), halo(_halo), superior(_superior), changed(&_changed) {}
+
+    void operator()(const cv::Range &range) const {
+        cv::Mat marker;
+
+        for (int i = range.start; i < range.end; i++) {
+            int t = active[i];
+            cv::Rect ext = haloRect(tiles[t], halo, output->size());
+            (*output)(ext).copyTo(marker);
+
+            if ( superior )
+                caib::morphSuprec(marker, mask(ext), marker, se);
+            else
+                caib::morphInfrec(marker, mask(ext), marker, se);
+
+            cv::Mat inner = marker(cv::Rect(tiles[t].tl() - ext.tl(), tiles[t].size()));
+            cv::Mat core = (*output)(tiles[t]);
+
+            (*changed)[t] = frameChanged(inner, core, halo);
+            inner.copyTo(core);
+        }
+    }
+
+private:
+    const cv::Mat &mask;
+    cv::Mat *output;
+    const cv::Mat &se;
+    const std::vector<cv::Rect> &tiles;
+    const std::vector<int> &active;
+    cv::Size halo;
+    bool superior;
+    std::vector<uchar> *changed;
+};
+
+/**
+ Apply a local operation tile by tile
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image
+ @param se
+ Structurant element
+ @param tile
+ Size of the tiles
+ @param op
+ Operation
+ @param passes
+ Number of erosions and dilatations of the operation, the halo grows with each one
+ */
+void tiledMorph(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const cv::Size &tile, const tileOp &op, const int &passes) {
+    CV_Assert( caib::isGray(input) && tile.width > 0 && tile.height > 0 );
+
+    cv::Size reach = seReach(se);
+    std::vector<cv::Rect> tiles = splitTiles(input.size(), tile);
+
+    //the halos are read in the input while other tiles are written
+    cv::Mat result = resultHeader(output, input, false);
+    result.create(input.size(), cv::DataType<uchar>::type);
+
+    cv::parallel_for_(cv::Range(0, (int) tiles.size()),
+                      tileMorphBody(input, result, se, tiles, cv::Size(passes * reach.width, passes * reach.height), op));
+
+    storeResult(result, output);
+}
+
+/**
+ Reconstruction tile by tile. The tiles are coloured by the parity of their column and
+ row, the tiles of a colour are done in parallel since their halos only reach tiles of
+ the other colours. The colours are swept until no frame of a tile changes
+ @param input1
+ Grayscale image that will be used to recontruct another image
+ @param input2
+ Grasycale image that will be reconstructed from another image
+ @param output
+ Output grayscale image
+ @param se
+ Structurant element
+ @param tile
+ Size of the tiles
+ @param superior
+ Superior reconstruction if TRUE, inferior if FALSE
+ */
+void tiledReconstruction(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output, const cv::Mat &se,
+                         const cv::Size &tile, const bool &superior) {
+    CV_Assert( caib::isGray(input1) && caib::isGray(input2) && input1.size() == input2.size() );
+    CV_Assert( tile.width > 0 && tile.height > 0 );
+
+    //the tiles can not be smaller than the halo, or the tiles of a colour would overlap
+    cv::Size halo = seReach(se);
+    cv::Size size( std::max(tile.width, halo.width), std::max(tile.height, halo.height) );
+    std::vector<cv::Rect> tiles = splitTiles(input1.size(), size);
+    int ntiles = (int) tiles.size(), tilesx = (input1.cols + size.width - 1) / size.width;
+
+    cv::Mat mask = sharesData(input2, output) ? input2.clone() : input2;
+
+    if ( superior )
+        caib::morphUnion(input1, mask, output);
+    else
+        caib::morphIntersec(input1, mask, output);
+
+    std::vector<uchar> pending(ntiles, 1), changed(ntiles, 0);
+    int npending = ntiles;
+
+    while ( npending > 0 ) {
+        for (int colour = 0; colour < 4; colour++) {
+            std::vector<int> active;
+
+            for (int t = 0; t < ntiles; t++) {
+                int tx = t % tilesx, ty = t / tilesx;
+                if ( pending[t] && (tx % 2) + 2 * (ty % 2) == colour ) {
+                    active.push_back(t);
+                    pending[t] = 0;
+                    npending--;
+                }
+            }
+
+            if ( active.empty() )
+                continue;
+
+            cv::parallel_for_(cv::Range(0, (int) active.size()),
+                              tileRecBody(mask, output, se, tiles, active, halo, superior, changed));
+
+            //the neighbours of a changed tile see new values in their halo
+            for (int i = 0; i < active.size(); i++) {
+                int t = active[i], tx = t % tilesx, ty = t / tilesx;
+                if ( !changed[t] )
+                    continue;
+
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        int nx = tx + dx, ny = ty + dy, n = nx + (ny * tilesx);
+                        if ( (dx == 0 && dy == 0) || nx < 0 || nx >= tilesx || ny < 0 || n >= ntiles || pending[n] )
+                            continue;
+
+                        pending[n] = 1;
+                        npending++;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ Apply the mathematical morphology erosion on a grayscale image, tile by tile
+ @param input
+ Input grayscale image
+ @param se
+ Structurant element
+ @param tile
+ Size of the tiles
+ @return Output grayscale image
+ */
+cv::Mat caib::tiledEro(const cv::Mat &input, const cv::Mat &se, const cv::Size &tile) {
+    cv::Mat output;
+    caib::tiledEro(input, output, se, tile);
+
+    return output;
+}
+
+/**
+ Apply the mathematical morphology erosion on a grayscale image, tile by tile
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param se
+ Structurant element
+ @param tile
+ Size of the tiles
+ */
+void caib::tiledEro(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const cv::Size &tile) {
+    tiledMorph(input, output, se, tile, TILE_ERO, 1);
+}
+
+/**
+ Apply the mathematical morphology dilatation on a grayscale image, tile by tile
+ @param input
+ Input grayscale image
+ @param se
+ Structurant element
+ @param tile
+ Size of the tiles
+ @return Output grayscale image
+ */
+cv::Mat caib::tiledDil(const cv::Mat &input, const cv::Mat &se, const cv::Size &tile) {
+    cv::Mat output;
+    caib::tiledDil(input, output, se, tile);
+
+    return output;
+}
+
+/**
+ Apply the mathematical morphology dilatation on a grayscale image, tile by tile
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param se
+ Structurant element
+ @param tile
+ Size of the tiles
+ */
+void caib::tiledDil(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const cv::Size &tile) {
+    tiledMorph(input, output, se, tile, TILE_DIL, 1);
+}
+
+/**
+ Apply the mathematical morphology opening on a grayscale image, tile by tile
+ @param input
+ Input grayscale image
+ @param se
+ Structurant element
+ @param tile
+ Size of the tiles
+ @return Output grayscale image
+ */
+cv::Mat caib::tiledOpen(const cv::Mat &input, const cv::Mat &se, const cv::Size &tile) {
+    cv::Mat output;
+    caib::tiledOpen(input, output, se, tile);
+
+    return output;
+}
+
+/**
+ Apply the mathematical morphology opening on a grayscale image, tile by tile
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param se
+ Structurant element
+ @param tile
+ Size of the tiles
+ */
+void caib::tiledOpen(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const cv::Size &tile) {
+    tiledMorph(input, output, se, tile, TILE_OPEN, 2);
+}
+
+/**
+ Apply the mathematical morphology closing on a grayscale image, tile by tile
+ @param input
+ Input grayscale image
+ @param se
+ Structurant element
+ @param tile
+ Size of the tiles
+ @return Output grayscale image
+ */
+cv::Mat caib::tiledClose(const cv::Mat &input, const cv::Mat &se, const cv::Size &tile) {
+    cv::Mat output;
+    caib::tiledClose(input, output, se, tile);
+
+    return output;
+}
+
+/**
+ Apply the mathematical morphology closing on a grayscale image, tile by tile
+ @param input
+ Input grayscale image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param se
+ Structurant element
+ @param tile
+ Size of the tiles
+ */
+void caib::tiledClose(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const cv::Size &tile) {
+    tiledMorph(input, output, se, tile, TILE_CLOSE, 2);
+}
+
+/**
+ Apply the mathematical morphology superior reconstuction of a grayscale image form
+ another grayscale image, tile by tile
+ @param input1
+ Grayscale image that will be used to recontruct another image
+ @param input2
+ Grasycale image that will be reconstructed from another image
+ @param se
+ Structurant element
+ @param tile
+ Size of the tiles
+ @return Output grayscale image
+ */
+cv::Mat caib::tiledSuprec(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se, const cv::Size &tile) {
+    cv::Mat output;
+    caib::tiledSuprec(input1, input2, output, se, tile);
+
+    return output;
+}
+
+/**
+ Apply the mathematical morphology superior reconstuction of a grayscale image form
+ another grayscale image, tile by tile. The output can be any of the inputs
+ @param input1
+ Grayscale image that will be used to recontruct another image
+ @param input2
+ Grasycale image that will be reconstructed from another image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param se
+ Structurant element
+ @param tile
+ Size of the tiles
+ */
+void caib::tiledSuprec(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output, const cv::Mat &se, const cv::Size &tile) {
+    tiledReconstruction(input1, input2, output, se, tile, true);
+}
+
+/**
+ Apply the mathematical morphology inferior reconstuction of a grayscale image form
+ another grayscale image, tile by tile
+ @param input1
+ Grayscale image that will be used to recontruct another image
+ @param input2
+ Grasycale image that will be reconstructed from another image
+ @param se
+ Structurant element
+ @param tile
+ Size of the tiles
+ @return Output grayscale image
+ */
+cv::Mat caib::tiledInfrec(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se, const cv::Size &tile) {
+    cv::Mat output;
+    caib::tiledInfrec(input1, input2, output, se, tile);
+
+    return output;
+}
+
+/**
+ Apply the mathematical morphology inferior reconstuction of a grayscale image form
+ another grayscale image, tile by tile. The output can be any of the inputs
+ @param input1
+ Grayscale image that will be used to recontruct another image
+ @param input2
+ Grasycale image that will be reconstructed from another image
+ @param output
+ Output grayscale image, reused if it has the right size and type
+ @param se
+ Structurant element
+ @param tile
+ Size of the tiles
+ */
+void caib::tiledInfrec(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output, const cv::Mat &se, const cv::Size &tile) {
+    tiledReconstruction(input1, input2, output, se, tile, false);
+}
@@ -0,0 +1,45 @@
+//
+//  tiled.h
+//  imgproc
+//
+//  Copyright (c) 2014 CAIB. All rights reserved.
+//
+//  Note: Morphology on large images split in tiles processed in parallel. Each tile
+//  is read with a halo sized from the structurant element, so the local operations
+//  give the same result as on the whole image. The reconstructions exchange the
+//  borders of the tiles until no value propagates from a tile to another.
+
+#ifndef __imgproc__tiled__
+#define __imgproc__tiled__
+
+#include <opencv/cv.h>
+#include <opencv/highgui.h>
+
+#include "utilities.h"
+#include "morph.h"
+
+#include <vector>
+
+namespace caib {
+
+    //Dilatations and Erosions
+    CAIB_EXPORTS cv::Mat tiledEro(const cv::Mat &input, const cv::Mat &se = morphSedefault(), const cv::Size &tile = cv::Size(512, 512));
+    CAIB_EXPORTS void tiledEro(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const cv::Size &tile = cv::Size(512, 512));
+    CAIB_EXPORTS cv::Mat tiledDil(const cv::Mat &input, const cv::Mat &se = morphSedefault(), const cv::Size &tile = cv::Size(512, 512));
+    CAIB_EXPORTS void tiledDil(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const cv::Size &tile = cv::Size(512, 512));
+
+    //Morphological Filters
+    CAIB_EXPORTS cv::Mat tiledOpen(const cv::Mat &input, const cv::Mat &se = morphSedefault(), const cv::Size &tile = cv::Size(512, 512));
+    CAIB_EXPORTS void tiledOpen(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const cv::Size &tile = cv::Size(512, 512));
+    CAIB_EXPORTS cv::Mat tiledClose(const cv::Mat &input, const cv::Mat &se = morphSedefault(), const cv::Size &tile = cv::Size(512, 512));
+    CAIB_EXPORTS void tiledClose(const cv::Mat &input, cv::Mat &output, const cv::Mat &se, const cv::Size &tile = cv::Size(512, 512));
+
+    //Conected Operators
+    CAIB_EXPORTS cv::Mat tiledSuprec(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se = morphSedefault(), const cv::Size &tile = cv::Size(512, 512));
+    CAIB_EXPORTS void tiledSuprec(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output, const cv::Mat &se, const cv::Size &tile = cv::Size(512, 512));
+    CAIB_EXPORTS cv::Mat tiledInfrec(const cv::Mat &input1, const cv::Mat &input2, const cv::Mat &se = morphSedefault(), const cv::Size &tile = cv::Size(512, 512));
+    CAIB_EXPORTS void tiledInfrec(const cv::Mat &input1, const cv::Mat &input2, cv::Mat &output, const cv::Mat &se, const cv::Size &tile = cv::Size(512, 512));
+
+};
+
+#endif /* defined(__imgproc__tiled__) */
@@ -18,18 +18,29 @@
  @return TRUE if the image is binary, FALSE if not
  */
 bool caib::isBinary(const cv::Mat &input) {
-    
-    int val;
     if ( !caib::isGray(input) )
         return false;
     
-    for ( int x = 0; x < input.cols; x++) {
-        for ( int y = 0; y < input.rows; y++) {
-            val = input.at<uchar>(cv::Point(x,y));
+    int cols = input.cols, rows = input.rows;
+    if ( input.isContinuous() ) {
+        cols *= rows;
+        rows = 1;
+    }
+    
+    //row-major scan by blocks, v is 0 or 255 only if (uchar)(v + 1) is 0 or 1, so the
+    //inner loop is a branchless or-reduction and the scan stops at the first bad block
+    for ( int y = 0; y < rows; y++ ) {
+        const uchar *row = input.ptr<uchar>(y);
+        
+        for ( int x = 0; x < cols; x += BINARY_BLOCK ) {
+            int end = std::min(cols, x + BINARY_BLOCK);
+            uchar bad = 0;
             
-            if ( val != 0  && val != 255 ) {
+            for ( int i = x; i < end; i++ )
+                bad |= (uchar)(row[i] + 1) >> 1;
+            
+            if ( bad )
                 return false;
-            }
         }
     }
     
@@ -49,6 +60,49 @@ bool caib::isGray(const cv::Mat &input) {
     return true;
 }
 
+/**
+ Check if an image holds single channel intensities of one of the depths handled by the
+ morphological kernels: 8-bit, 16-bit or float
+ @param input
+ The input image to be checked
+ @return TRUE if the image is a grayscale image of a supported depth, FALSE if not
+ */
+bool caib::isIntensity(const cv::Mat &input) {
+    if ( input.channels() != 1 )
+        return false;
+    
+    return input.depth() == CV_8U || input.depth() == CV_16U || input.depth() == CV_32F;
+}
+
+/**
+ Wrap a binary image, checking it once so the functions taking a BinaryMat skip the scan
+ @param input
+ Input binary image, shared and not copied
+ */
+caib::BinaryMat::BinaryMat(const cv::Mat &input) {
+    CV_Assert( caib::isBinary(input) );
+    
+    image = input;
+}
+
+/**
+ Binarize an intensity image, the pixels above the threshold become 255 and the others 0.
+ The result is binary by construction and is not scanned again
+ @param input
+ Input intensity image
+ @param thresh
+ Threshold
+ @return Binary image
+ */
+caib::BinaryMat caib::BinaryMat::threshold(const cv::Mat &input, const double &thresh) {
+    CV_Assert( caib::isIntensity(input) );
+    
+    caib::BinaryMat output;
+    cv::compare(input, thresh, output.image, cv::CMP_GT);
+    
+    return output;
+}
+
 /**
  Check if two images have their pixels intensities equal
  @param input1
@@ -85,12 +139,117 @@ bool caib::isInside(const cv::Mat &input, const cv::Point &pt) {
     return false;
 }
 
+//Mark the boundary of the labels on a band of rows: a pixel is on the boundary when more
+//than one of its neighbours E, SW, S and SE has another label. The last row has no row
+//below, so there NE stands for SE and the vertical boundaries still reach the frame. Only
+//two rows are read, so the rows are independent, and each neighbour is compared over the
+//whole row in a loop the compiler can vectorize
+class labelsBoundaryBody : public cv::ParallelLoopBody {
+public:
+    labelsBoundaryBody(const cv::Mat &labels, cv::Mat &mask)
+    : labels(labels), mask(&mask) {}
+    
+    void operator()(const cv::Range &range) const {
+        int cols = labels.cols;
+        std::vector<uchar> count(cols + 1);
+        uchar *n = &count[0];
+        
+        for ( int y = range.start; y < range.end; y++ ) {
+            const int *lab = labels.ptr<int>(y);
+            uchar *out = mask->ptr(y);
+            
+            for ( int x = 0; x < cols - 1; x++ )
+                n[x] = lab[x] != lab[x + 1];
+            n[cols - 1] = 0;
+            
+            if ( y + 1 < labels.rows ) {
+                const int *below = labels.ptr<int>(y + 1);
+                
+                for ( int x = 0; x < cols; x++ )
+                    n[x] += lab[x] != below[x];
+                for ( int x = 1; x < cols; x++ )
+                    n[x] += lab[x] != below[x - 1];
+                for ( int x = 0; x < cols - 1; x++ )
+                    n[x] += lab[x] != below[x + 1];
+            } else if ( y > 0 ) {
+                const int *above = labels.ptr<int>(y - 1);
+                
+                for ( int x = 0; x < cols - 1; x++ )
+                    n[x] += lab[x] != above[x + 1];
+            }
+            
+            for ( int x = 0; x < cols; x++ )
+                out[x] = n[x] > 1 ? 255 : 0;
+        }
+    }
+    
+private:
+    const cv::Mat &labels;
+    cv::Mat *mask;
+};
+
+/**
+ Find the boundary of the labels of a labeled image. A pixel is on the boundary when
+ more than one of its neighbours to the right and below has another label, so the
+ boundary is one pixel thick and lies on the upper left side of each label change. On the
+ last row the neighbour above right replaces the missing ones below
+ @param labels
+ Labeled image
+ @return Binary mask of the boundary
+ */
+cv::Mat caib::labelsBoundary(const cv::Mat &labels) {
+    
+    CV_Assert (labels.type() == cv::DataType<int>::type);
+    
+    cv::Mat mask(labels.size(), cv::DataType<uchar>::type);
+    if ( !labels.empty() )
+        cv::parallel_for_(cv::Range(0, labels.rows), labelsBoundaryBody(labels, mask));
+    
+    return mask;
+}
+
+/**
+ Find the boundary of the labels of a labeled image as horizontal runs, following the
+ rule of labelsBoundary
+ @param labels
+ Labeled image
+ @return Runs of boundary pixels in row-major order
+ */
+std::vector<caib::pixelRun> caib::labelsBoundaryRuns(const cv::Mat &labels) {
+    
+    cv::Mat mask = caib::labelsBoundary(labels);
+    std::vector<caib::pixelRun> runs;
+    
+    for ( int y = 0; y < mask.rows; y++ ) {
+        const uchar *row = mask.ptr(y);
+        
+        for ( int x = 0; x < mask.cols; x++ ) {
+            if ( row[x] == 0 )
+                continue;
+            
+            caib::pixelRun run;
+            run.y = y;
+            run.x = x;
+            
+            while ( x < mask.cols && row[x] != 0 )
+                x++;
+            
+            run.length = x - run.x;
+            runs.push_back(run);
+        }
+    }
+    
+    return runs;
+}
+
 /**
  Draw the contour labels given by Labeled image
  @param input
  Input Image in which the contours will be drawn
  @param labels
  Labels that will be drawn
+ @param color
+ Color of the contours
  @return Output image with contours of the labels drawn
  */
 cv::Mat caib::drawLabelsContours(const cv::Mat &input, const cv::Mat& labels, const cv::Scalar &color) {
@@ -98,48 +257,183 @@ cv::Mat caib::drawLabelsContours(const cv::Mat &input, const cv::Mat& labels, co
     CV_Assert (labels.type() == cv::DataType<int>::type && labels.cols == input.cols && labels.rows == input.rows && input.type() == cv::DataType<cv::Vec3b>::type );
     
     cv::Mat output = input.clone();
+    output.setTo(color, caib::labelsBoundary(labels));
+    
+    return output;
+}
+
+//Index of each label, found through a direct table when the labels are dense or by a
+//binary search on the sorted labels otherwise
+struct labelTable {
+    int low, high;                      //smallest and largest label
+    int size;                           //number of indexes
+    std::vector<int> keys;              //sorted labels, empty when the table is direct
+    
+    //index of a label, -1 if it is not in the table
+    int index(const int &label) const {
+        if ( keys.empty() )
+            return label >= low && label <= high ? label - low : -1;
+        
+        std::vector<int>::const_iterator it = std::lower_bound(keys.begin(), keys.end(), label);
+        return it != keys.end() && *it == label ? (int)(it - keys.begin()) : -1;
+    }
+    
+    //label of an index
+    int label(const int &i) const {
+        return keys.empty() ? low + i : keys[i];
+    }
+};
+
+//Build the index of the labels of a labeled image
+labelTable indexLabels(const cv::Mat &labels) {
+    labelTable table;
+    int rows = labels.rows, cols = labels.cols;
+    double low = 0, high = -1;
     
-    const int dx8[8] = {-1, -1,  0,  1, 1, 1, 0, -1};
-	const int dy8[8] = { 0, -1, -1, -1, 0, 1, 1,  1};
+    if ( !labels.empty() )
+        cv::minMaxLoc(labels, &low, &high);
     
-	int sz = labels.cols*labels.rows;
+    table.low = (int)low;
+    table.high = (int)high;
+    table.size = (int)(high - low + 1);
+    
+    if ( high - low + 1 > std::max(2.0 * rows * cols, 65536.0) ) {
+        table.keys.reserve(rows * cols);
+        for ( int y = 0; y < rows; y++ )
+            table.keys.insert(table.keys.end(), labels.ptr<int>(y), labels.ptr<int>(y) + cols);
+        
+        std::sort(table.keys.begin(), table.keys.end());
+        table.keys.erase(std::unique(table.keys.begin(), table.keys.end()), table.keys.end());
+        table.size = (int)table.keys.size();
+    }
+    
+    return table;
+}
+
+//Indexes of the labels present in a labeled image, in the row-major or column-major
+//order of the first pixel of each label
+std::vector<int> labelsOrder(const cv::Mat &labels, const labelTable &table, const bool &columnMajor) {
+    int rows = labels.rows, cols = labels.cols;
+    std::vector<int> first(table.size, rows * cols);
+    
+    for ( int y = 0; y < rows; y++ ) {
+        const int *row = labels.ptr<int>(y);
+        
+        for ( int x = 0; x < cols; x++ ) {
+            int i = table.index(row[x]);
+            first[i] = std::min(first[i], columnMajor ? x * rows + y : y * cols + x);
+        }
+    }
+    
+    std::vector<std::pair<int, int> > sorted;
+    for ( int i = 0; i < table.size; i++ ) {
+        if ( first[i] < rows * cols )
+            sorted.push_back(std::make_pair(first[i], i));
+    }
     
-    std::vector<bool> istaken(sz, false);
+    std::sort(sorted.begin(), sorted.end());
     
-	int mainindex(0);
-	for( int j = 0; j < labels.rows; j++ )
-	{
-		for( int k = 0; k < labels.cols; k++ )
-		{
-			int np(0);
-			for( int i = 0; i < 8; i++ )
-			{
-				int x = k + dx8[i];
-				int y = j + dy8[i];
+    std::vector<int> order(sorted.size());
+    for ( int i = 0; i < sorted.size(); i++ )
+        order[i] = sorted[i].second;
+    
+    return order;
+}
+
+//Give every label its random color, drawn in the column-major order of the first pixel
+//of each label so the colors do not depend on the painting order
+std::vector<cv::Vec3b> colorLabels(const cv::Mat &labels, const labelTable &table) {
+    std::vector<int> order = labelsOrder(labels, table, true);
+    std::vector<cv::Vec3b> colors(table.size);
+    cv::RNG rng(12345);
+    
+    for ( int i = 0; i < order.size(); i++ ) {
+        int b = rng.uniform(0, 255);
+        int g = rng.uniform(0, 255);
+        int r = rng.uniform(0, 255);
+        colors[order[i]] = cv::Vec3b((uchar)b, (uchar)g, (uchar)r);
+    }
+    
+    return colors;
+}
+
+//Mix a color over a pixel with the given opacity
+inline cv::Vec3b blendColor(const cv::Vec3b &pixel, const cv::Vec3b &color, const double &alpha) {
+    cv::Vec3b mixed;
+    for ( int c = 0; c < 3; c++ )
+        mixed[c] = cv::saturate_cast<uchar>(pixel[c] * (1 - alpha) + color[c] * alpha);
+    
+    return mixed;
+}
+
+//Paint the labels row by row, over the input image when it is given
+class paintLabelsBody : public cv::ParallelLoopBody {
+public:
+    paintLabelsBody(const cv::Mat &labels, const labelTable &table, const std::vector<cv::Vec3b> &colors, const cv::Mat &input, const double &alpha, cv::Mat &output)
+    : labels(labels), table(table), colors(colors), input(input), alpha(alpha), output(&output) {}
+    
+    void operator()(const cv::Range &range) const {
+        for ( int y = range.start; y < range.end; y++ ) {
+            const int *lab = labels.ptr<int>(y);
+            cv::Vec3b *out = output->ptr<cv::Vec3b>(y);
+            
+            //the labels come in runs, the last one found is kept
+            int last = lab[0];
+            cv::Vec3b color = colors[table.index(last)];
+            
+            for ( int x = 0; x < labels.cols; x++ ) {
+                if ( lab[x] != last ) {
+                    last = lab[x];
+                    color = colors[table.index(last)];
+                }
                 
-				if( (x >= 0 && x < labels.cols) && (y >= 0 && y < labels.rows) )
-				{
-					int index = y*labels.cols + x;
-                    
-					if( false == istaken[index] )//comment this to obtain internal contours
-					{
-						if( labels.ptr<int>()[mainindex] != labels.ptr<int>()[index] ) np++;
-					}
-				}
-			}
-			if( np > 1 )//change to 2 or 3 for thinner lines
-			{
-                for (int c = 0; c < output.channels(); c++) {
-                    output.ptr()[output.channels()*mainindex + c] = color[c];
+                out[x] = input.empty() ? color : blendColor(input.ptr<cv::Vec3b>(y)[x], color, alpha);
+            }
+        }
+    }
+    
+private:
+    const cv::Mat &labels;
+    const labelTable &table;
+    const std::vector<cv::Vec3b> &colors;
+    const cv::Mat &input;
+    double alpha;
+    cv::Mat *output;
+};
+
+//Paint one label row by row, over the input image when it is given
+class paintLabelBody : public cv::ParallelLoopBody {
+public:
+    paintLabelBody(const cv::Mat &labels, const int &label, const cv::Vec3b &color, const cv::Mat &input, const double &alpha, cv::Mat &output)
+    : labels(labels), label(label), color(color), input(input), alpha(alpha), output(&output) {}
+    
+    void operator()(const cv::Range &range) const {
+        for ( int y = range.start; y < range.end; y++ ) {
+            const int *lab = labels.ptr<int>(y);
+            cv::Vec3b *out = output->ptr<cv::Vec3b>(y);
+            
+            if ( input.empty() ) {
+                for ( int x = 0; x < labels.cols; x++ ) {
+                    if ( lab[x] == label )
+                        out[x] = color;
                 }
-				istaken[mainindex] = true;
-			}
-			mainindex++;
-		}
-	}
+            } else {
+                const cv::Vec3b *in = input.ptr<cv::Vec3b>(y);
+                
+                for ( int x = 0; x < labels.cols; x++ )
+                    out[x] = lab[x] == label ? blendColor(in[x], color, alpha) : in[x];
+            }
+        }
+    }
     
-    return output;
-  }
+private:
+    const cv::Mat &labels;
+    int label;
+    cv::Vec3b color;
+    const cv::Mat &input;
+    double alpha;
+    cv::Mat *output;
+};
 
 /**
  Paint every label passed on an labeled image
@@ -153,43 +447,45 @@ cv::Mat caib::paintLabels(const cv::Mat &labels) {
 	
     cv::Mat output = cv::Mat(labels.size(), cv::DataType<cv::Vec3b>::type);
     
-    std::vector<cv::Vec3b> colorTab;
-    std::vector<int> label;
-    cv::RNG rng(12345);
-    cv::Vec3b color;
-    
-	for(int x=0; x<labels.cols; x++)
-	{
-		for(int y=0; y<labels.rows; y++)
-		{
-            std::vector<int>::iterator it = std::find(label.begin(), label.end(), labels.ptr<int>()[x + ( y * labels.cols)]);
-            
-            if (it != label.end()) {
-                color = colorTab[it - label.begin()];
-            } else {
-                int b = rng.uniform(0, 255);
-                int g = rng.uniform(0, 255);
-                int r = rng.uniform(0, 255);
-                color = cv::Vec3b((uchar)b, (uchar)g, (uchar)r);
-                
-                colorTab.push_back(color);
-                label.push_back( labels.ptr<int>()[x + (y * labels.cols)] );
-            }
-            
-            output.ptr()[( (x + (y * output.cols)) * output.channels() ) + 0 ] = color[0];
-            output.ptr()[( (x + (y * output.cols)) * output.channels() ) + 1 ] = color[1];
-            output.ptr()[( (x + (y * output.cols)) * output.channels() ) + 2 ] = color[2];
-		}
-	}
+    labelTable table = indexLabels(labels);
+    std::vector<cv::Vec3b> colors = colorLabels(labels, table);
+    cv::parallel_for_(cv::Range(0, labels.rows), paintLabelsBody(labels, table, colors, cv::Mat(), 1, output));
     
 	return output;
 }
 
+/**
+ Paint every label of a labeled image over an image, with the colors of paintLabels
+ @param input
+ Image on which the labels are painted
+ @param labels
+ Labeled image
+ @param alpha
+ Opacity of the colors, from 0 to 1
+ @return Output image with every label blended with a different color
+ */
+cv::Mat caib::paintLabels(const cv::Mat &input, const cv::Mat &labels, const double &alpha) {
+    
+    CV_Assert (labels.type() == cv::DataType<int>::type && labels.size() == input.size() && input.type() == cv::DataType<cv::Vec3b>::type && alpha >= 0 && alpha <= 1);
+    
+    cv::Mat output = cv::Mat(labels.size(), cv::DataType<cv::Vec3b>::type);
+    
+    labelTable table = indexLabels(labels);
+    std::vector<cv::Vec3b> colors = colorLabels(labels, table);
+    cv::parallel_for_(cv::Range(0, labels.rows), paintLabelsBody(labels, table, colors, input, alpha, output));
+    
+    return output;
+}
+
 /**
  Paint every label passed on an labeled image
  @param labels
  Labeled image
- @return Output image with every label painted with a different color
+ @param label
+ Label to be painted
+ @param color
+ Color of the label
+ @return Output image with the label painted
  */
 cv::Mat caib::paintLabel(const cv::Mat &labels, const int &label, const cv::Scalar &color) {
     
@@ -197,21 +493,38 @@ cv::Mat caib::paintLabel(const cv::Mat &labels, const int &label, const cv::Scal
 	
     cv::Mat output = cv::Mat::zeros(labels.size(), cv::DataType<cv::Vec3b>::type);
     
-	for(int x=0; x<labels.cols; x++)
-	{
-		for(int y=0; y<labels.rows; y++)
-		{
-            if (labels.ptr<int>()[x + (y * labels.cols)] == label) {
-                output.ptr()[( (x + (y * output.cols)) * output.channels() ) + 0 ] = color[0];
-                output.ptr()[( (x + (y * output.cols)) * output.channels() ) + 1 ] = color[1];
-                output.ptr()[( (x + (y * output.cols)) * output.channels() ) + 2 ] = color[2];
-            }
-		}
-	}
+    cv::Vec3b c(cv::saturate_cast<uchar>(color[0]), cv::saturate_cast<uchar>(color[1]), cv::saturate_cast<uchar>(color[2]));
+    cv::parallel_for_(cv::Range(0, labels.rows), paintLabelBody(labels, label, c, cv::Mat(), 1, output));
     
 	return output;
 }
 
+/**
+ Paint one label of a labeled image over an image
+ @param input
+ Image on which the label is painted
+ @param labels
+ Labeled image
+ @param label
+ Label to be painted
+ @param color
+ Color of the label
+ @param alpha
+ Opacity of the color, from 0 to 1
+ @return Output image with the label blended
+ */
+cv::Mat caib::paintLabel(const cv::Mat &input, const cv::Mat &labels, const int &label, const cv::Scalar &color, const double &alpha) {
+    
+    CV_Assert(labels.type() == cv::DataType<int>::type && labels.size() == input.size() && input.type() == cv::DataType<cv::Vec3b>::type && alpha >= 0 && alpha <= 1);
+    
+    cv::Mat output = cv::Mat(labels.size(), cv::DataType<cv::Vec3b>::type);
+    
+    cv::Vec3b c(cv::saturate_cast<uchar>(color[0]), cv::saturate_cast<uchar>(color[1]), cv::saturate_cast<uchar>(color[2]));
+    cv::parallel_for_(cv::Range(0, labels.rows), paintLabelBody(labels, label, c, input, alpha, output));
+    
+    return output;
+}
+
 /**
  Calculates the histogram for a Grayscale image
  @param input
@@ -244,10 +557,191 @@ caib::histogram caib::calcHistogram(const cv::Mat &input, int nbins, bool unifor
 }
 
 
+//Bins of one dimension of a histogram, the values outside the range are not counted
+struct histAxis {
+    int channel;                //channel of the image
+    int bins;                   //number of bins
+    int stride;                 //distance between two bins of this dimension in the histogram
+    bool uniform;
+    double scale, shift;        //uniform bins: the bin of v is floor(v * scale + shift)
+    std::vector<float> edges;   //bounds of the bins when they are not uniform
+    std::vector<int> lut;       //bin of each byte value
+    
+    int bin(const float &v) const {
+        if ( uniform ) {
+            int b = cvFloor(v * scale + shift);
+            return (unsigned)b < (unsigned)bins ? b : -1;
+        }
+        
+        if ( !(v >= edges[0] && v < edges[bins]) )
+            return -1;
+        
+        return (int)(std::upper_bound(edges.begin(), edges.end(), v) - edges.begin()) - 1;
+    }
+    int bin(const ushort &v) const { return bin((float)v); }
+    int bin(const uchar &v) const { return lut[v]; }
+};
+
+//Describe the dimensions of a histogram the way cv::calcHist takes them
+std::vector<histAxis> histAxes(const cv::Mat &input, const std::vector<int> &channels, const std::vector<int> &histSize, const float *ranges[], const bool &uniform) {
+    std::vector<histAxis> axes(channels.size());
+    int stride = 1;
+    
+    for ( int d = (int)channels.size() - 1; d >= 0; d-- ) {
+        CV_Assert( channels[d] >= 0 && channels[d] < input.channels() && histSize[d] > 0 );
+        
+        histAxis &axis = axes[d];
+        axis.channel = channels[d];
+        axis.bins = histSize[d];
+        axis.stride = stride;
+        axis.uniform = uniform;
+        stride *= axis.bins;
+        
+        if ( uniform ) {
+            axis.scale = axis.bins / ((double)ranges[d][1] - ranges[d][0]);
+            axis.shift = -ranges[d][0] * axis.scale;
+        } else {
+            axis.edges.assign(ranges[d], ranges[d] + axis.bins + 1);
+        }
+        
+        if ( input.depth() == CV_8U ) {
+            axis.lut.resize(256);
+            for ( int v = 0; v < 256; v++ )
+                axis.lut[v] = axis.bin((float)v);
+        }
+    }
+    
+    return axes;
+}
+
+//Histograms of the labels found in a band of rows
+struct labelHistStripe {
+    std::vector<int> labels;    //index of each label found, in the order found
+    std::vector<float> bins;    //histograms of the labels found, one after the other
+};
+
+//Accumulate the histograms of the labels on bands of rows, each band in its own
+//accumulators so no band waits for another
+template <class T>
+class labelHistBody : public cv::ParallelLoopBody {
+public:
+    labelHistBody(const cv::Mat &input, const cv::Mat &labels, const labelTable &table, const std::vector<histAxis> &axes, const int &total, const int &stripRows, std::vector<labelHistStripe> &stripes)
+    : input(input), labels(labels), table(table), axes(axes), total(total), stripRows(stripRows), stripes(&stripes) {}
+    
+    void operator()(const cv::Range &range) const {
+        int cn = input.channels(), dims = (int)axes.size();
+        std::vector<int> slot(table.size);
+        
+        for ( int s = range.start; s < range.end; s++ ) {
+            labelHistStripe &acc = (*stripes)[s];
+            std::fill(slot.begin(), slot.end(), -1);
+            
+            for ( int y = s * stripRows; y < std::min(labels.rows, (s + 1) * stripRows); y++ ) {
+                const T *in = input.ptr<T>(y);
+                const int *lab = labels.ptr<int>(y);
+                
+                //the labels come in runs, the last one found is kept
+                int last = lab[0], i = table.index(last);
+                
+                for ( int x = 0; x < labels.cols; x++, in += cn ) {
+                    if ( lab[x] != last ) {
+                        last = lab[x];
+                        i = table.index(last);
+                    }
+                    
+                    if ( i < 0 )
+                        continue;
+                    
+                    int bin = 0, d = 0;
+                    for ( ; d < dims; d++ ) {
+                        int b = axes[d].bin(in[axes[d].channel]);
+                        if ( b < 0 )
+                            break;
+                        bin += b * axes[d].stride;
+                    }
+                    
+                    if ( d < dims )
+                        continue;
+                    
+                    if ( slot[i] < 0 ) {
+                        slot[i] = (int)acc.labels.size();
+                        acc.labels.push_back(i);
+                        acc.bins.resize(acc.bins.size() + total, 0);
+                    }
+                    
+                    acc.bins[slot[i] * total + bin]++;
+                }
+            }
+        }
+    }
+    
+private:
+    const cv::Mat &input;
+    const cv::Mat &labels;
+    const labelTable &table;
+    const std::vector<histAxis> &axes;
+    int total, stripRows;
+    std::vector<labelHistStripe> *stripes;
+};
+
+//Fill the histograms of the labels of a table in one scan of the image, the histogram i
+//belongs to the label index order[i]
+std::vector<cv::MatND> labelHistograms(const cv::Mat &input, const cv::Mat &labels, const labelTable &table, const std::vector<int> &order, const std::vector<int> &channels, const std::vector<int> &histSize, const float *ranges[], const bool &uniform) {
+    
+    CV_Assert( labels.type() == cv::DataType<int>::type && labels.size() == input.size() );
+    CV_Assert( input.depth() == CV_8U || input.depth() == CV_16U || input.depth() == CV_32F );
+    CV_Assert( !channels.empty() && channels.size() == histSize.size() );
+    
+    std::vector<histAxis> axes = histAxes(input, channels, histSize, ranges, uniform);
+    int total = axes[0].stride * axes[0].bins;
+    
+    int nstrips = std::max(1, std::min(labels.rows, cv::getNumThreads() * 4));
+    int stripRows = (labels.rows + nstrips - 1) / nstrips;
+    nstrips = labels.rows > 0 ? (labels.rows + stripRows - 1) / stripRows : 0;
+    
+    std::vector<labelHistStripe> stripes(nstrips);
+    
+    if ( input.depth() == CV_8U )
+        cv::parallel_for_(cv::Range(0, nstrips), labelHistBody<uchar>(input, labels, table, axes, total, stripRows, stripes));
+    else if ( input.depth() == CV_16U )
+        cv::parallel_for_(cv::Range(0, nstrips), labelHistBody<ushort>(input, labels, table, axes, total, stripRows, stripes));
+    else
+        cv::parallel_for_(cv::Range(0, nstrips), labelHistBody<float>(input, labels, table, axes, total, stripRows, stripes));
+    
+    //merge the accumulators of the bands
+    std::vector<cv::MatND> hists(order.size());
+    std::vector<int> position(table.size, -1);
+    
+    for ( int i = 0; i < order.size(); i++ ) {
+        position[order[i]] = i;
+        
+        if ( histSize.size() == 1 )
+            hists[i] = cv::Mat::zeros(histSize[0], 1, cv::DataType<float>::type);
+        else
+            hists[i] = cv::Mat::zeros((int)histSize.size(), &histSize[0], cv::DataType<float>::type);
+    }
+    
+    for ( int s = 0; s < nstrips; s++ ) {
+        for ( int k = 0; k < stripes[s].labels.size(); k++ ) {
+            int p = position[stripes[s].labels[k]];
+            if ( p < 0 )
+                continue;
+            
+            float *hist = hists[p].ptr<float>();
+            const float *bins = &stripes[s].bins[k * total];
+            
+            for ( int b = 0; b < total; b++ )
+                hist[b] += bins[b];
+        }
+    }
+    
+    return hists;
+}
+
 /**
- Calculates the histogram for each label
+ Calculates the histogram for each label in a single scan of the image
  @param input
- Input image from which data will be used
+ Input image from which data will be used, of 8-bit, 16-bit or float pixels
  @param labels
  Labeled image
  @param channels
@@ -258,37 +752,52 @@ caib::histogram caib::calcHistogram(const cv::Mat &input, int nbins, bool unifor
  Range of each channel
  @param uniform
  Uniform distribution
- @param accumulate
- Accumulate bin values
- @return Histogram of each label passed in labels
+ @return Histogram of each label passed in labels, in the row-major order of the first
+ pixel of each label
  */
-
-/*
-std::vector<cv::MatND> caib::calcLabelHist(const cv::Mat &input, cv::Mat labels, const std::vector<int> &channels, const std::vector<int> &histSize, const float *ranges[], bool uniform, bool accumulate) {
-    
-    CV_Assert (labels.type() == cv::DataType<int>::type && labels.cols == input.cols && labels.rows == input.rows );
-    
+std::vector<cv::MatND> caib::calcLabelHist(const cv::Mat &input, const cv::Mat &labels, const std::vector<int> &channels, const std::vector<int> &histSize, const float *ranges[], bool uniform) {
     std::vector<int> id_labels;
-    for (int i = 0; i < labels.cols * labels.rows; i++) {
-        if (std::find(id_labels.begin(), id_labels.end(), labels.ptr<int>()[i]) == id_labels.end() ) {
-            id_labels.push_back(labels.ptr<int>()[i]);
-        }
-    }
     
-    std::vector<cv::MatND> hists = std::vector<cv::MatND>(id_labels.size(), cv::MatND());
+    return caib::calcLabelHist(input, labels, id_labels, channels, histSize, ranges, uniform);
+}
+
+/**
+ Calculates the histogram for each label in a single scan of the image
+ @param input
+ Input image from which data will be used, of 8-bit, 16-bit or float pixels
+ @param labels
+ Labeled image
+ @param id_labels
+ Label of each histogram
+ @param channels
+ Channels that will be used to compute the histograms
+ @param histSize
+ Number of bins for each channel
+ @param ranges
+ Range of each channel
+ @param uniform
+ Uniform distribution
+ @return Histogram of each label passed in labels, in the row-major order of the first
+ pixel of each label
+ */
+std::vector<cv::MatND> caib::calcLabelHist(const cv::Mat &input, const cv::Mat &labels, std::vector<int> &id_labels, const std::vector<int> &channels, const std::vector<int> &histSize, const float *ranges[], bool uniform) {
     
-    for (long i=0 ; i < id_labels.size(); i++) {
-        hists[i] = caib::calcLabelHist(input, labels, id_labels[i], channels, histSize, ranges, uniform, accumulate);
-    }
+    CV_Assert (labels.type() == cv::DataType<int>::type);
     
-    return hists;
+    labelTable table = indexLabels(labels);
+    std::vector<int> order = labelsOrder(labels, table, false);
     
-}*/
+    id_labels.resize(order.size());
+    for (int i = 0; i < order.size(); i++)
+        id_labels[i] = table.label(order[i]);
+    
+    return labelHistograms(input, labels, table, order, channels, histSize, ranges, uniform);
+}
 
 /**
  Calculates the histogram for a specific label
  @param input
- Input image from which data will be used
+ Input image from which data will be used, of 8-bit, 16-bit or float pixels
  @param labels
  Labeled image
  @param label
@@ -301,89 +810,429 @@ std::vector<cv::MatND> caib::calcLabelHist(const cv::Mat &input, cv::Mat labels,
  Range of each channel
  @param uniform
  Uniform distribution
- @param accumulate
- Accumulate bin values
- @return Histogram of each label passed in labels
+ @return Histogram of the label, empty bins if the label is not in labels
  */
+cv::MatND caib::calcLabelHist(const cv::Mat &input, const cv::Mat &labels, const int &label, const std::vector<int> &channels, const std::vector<int> &histSize, const float *ranges[], bool uniform) {
+    
+    labelTable table;
+    table.low = table.high = label;
+    table.size = 1;
+    
+    return labelHistograms(input, labels, table, std::vector<int>(1, 0), channels, histSize, ranges, uniform)[0];
+}
 
-/*
-cv::MatND caib::calcLabelHist(const cv::Mat &input, cv::Mat labels, const int &label, const std::vector<int> &channels, const std::vector<int> &histSize, const float *ranges[], bool uniform, bool accumulate) {
+//Pixel pairs across two regions, the consecutive pairs of the same regions are merged
+struct edgeSample {
+    int a, b;           //region indexes, a < b
+    int count;          //number of pixel pairs
+    double sum;         //sum of the intensity differences
+    float max;          //largest intensity difference
     
-    CV_Assert (labels.type() == cv::DataType<int>::type && labels.cols == input.cols && labels.rows == input.rows );
+    bool operator<(const edgeSample &other) const {
+        return a < other.a || (a == other.a && b < other.b);
+    }
+};
+
+//Intensity difference between two pixels, the euclidean distance of their channels
+template <class T>
+inline float pixelDistance(const T *p, const T *q, const int &cn) {
+    double d = 0;
+    for ( int c = 0; c < cn; c++ )
+        d += ((double)p[c] - q[c]) * ((double)p[c] - q[c]);
     
-    cv::MatND hist;
-    cv::Mat image = input.clone();
-    cv::Mat mask = cv::Mat::zeros(labels.size(), cv::DataType<uchar>::type);
+    return cn == 1 ? (float)std::abs((double)p[0] - q[0]) : (float)std::sqrt(d);
+}
+
+//Collect the pixel pairs across regions on bands of rows, comparing each pixel with its
+//neighbours to the right and below so every pair is seen once. The regions found are
+//marked in a table shared by the bands, which only ever write ones in it
+template <class T>
+class labelsGraphBody : public cv::ParallelLoopBody {
+public:
+    labelsGraphBody(const cv::Mat &labels, const labelTable &table, const cv::Mat &input, const int &connectivity, const int &stripRows, std::vector<std::vector<edgeSample> > &samples, std::vector<char> &present)
+    : labels(labels), table(table), input(input), connectivity(connectivity), stripRows(stripRows), samples(&samples), present(&present) {}
     
-    for (int i=0; i < labels.cols*labels.rows; i++) {
-        if (labels.ptr<int>()[i] == label) {
-            mask.ptr()[i] = 255;
+    void operator()(const cv::Range &range) const {
+        int cols = labels.cols, cn = input.empty() ? 0 : input.channels();
+        const int dx[4] = {1, 0, 1, -1};
+        const int dy[4] = {0, 1, 1, 1};
+        int nn = connectivity == 4 ? 2 : 4;
+        
+        std::vector<int> cur(cols), next(cols);
+        std::vector<char> &seen = *present;
+        
+        for ( int s = range.start; s < range.end; s++ ) {
+            std::vector<edgeSample> &out = (*samples)[s];
+            
+            int y0 = s * stripRows, y1 = std::min(labels.rows, (s + 1) * stripRows);
+            indexRow(y0, cur);
+            
+            for ( int y = y0; y < y1; y++ ) {
+                if ( y + 1 < labels.rows )
+                    indexRow(y + 1, next);
+                
+                for ( int x = 0; x < cols; x++ ) {
+                    int a = cur[x];
+                    if ( x == 0 || a != cur[x - 1] )
+                        seen[a] = 1;
+                    
+                    for ( int k = 0; k < nn; k++ ) {
+                        int nx = x + dx[k], ny = y + dy[k];
+                        if ( nx < 0 || nx >= cols || ny >= labels.rows )
+                            continue;
+                        
+                        int b = dy[k] == 0 ? cur[nx] : next[nx];
+                        if ( a == b )
+                            continue;
+                        
+                        float d = cn == 0 ? 0 : pixelDistance(input.ptr<T>(y) + x * cn, input.ptr<T>(ny) + nx * cn, cn);
+                        
+                        edgeSample e;
+                        e.a = std::min(a, b);
+                        e.b = std::max(a, b);
+                        
+                        if ( !out.empty() && out.back().a == e.a && out.back().b == e.b ) {
+                            out.back().count++;
+                            out.back().sum += d;
+                            out.back().max = std::max(out.back().max, d);
+                        } else {
+                            e.count = 1;
+                            e.sum = d;
+                            e.max = d;
+                            out.push_back(e);
+                        }
+                    }
+                }
+                
+                std::swap(cur, next);
+            }
         }
     }
     
-    cv::calcHist(&image, 1, channels.data(), mask, hist, (int) channels.size(), histSize.data(), ranges, uniform, accumulate);
-    
+private:
+    //region index of each pixel of a row
+    void indexRow(const int &y, std::vector<int> &index) const {
+        const int *lab = labels.ptr<int>(y);
+        int last = lab[0], i = table.index(last);
+        
+        for ( int x = 0; x < labels.cols; x++ ) {
+            if ( lab[x] != last ) {
+                last = lab[x];
+                i = table.index(last);
+            }
+            index[x] = i;
+        }
+    }
     
-    return hist;
-} */
+    const cv::Mat &labels;
+    const labelTable &table;
+    const cv::Mat &input;
+    int connectivity, stripRows;
+    std::vector<std::vector<edgeSample> > *samples;
+    std::vector<char> *present;
+};
 
 /**
- Retrieves the labels adjancy list
+ Build the region adjacency graph of a labeled image in one scan, with the length of the
+ boundary shared by each pair of regions and the intensity contrast across it
  @param labels
  Labeled image
- @param id_labels
- Id of each label in the labeled image (pass initially empty)
- @return The adjancy list of each label in the image
+ @param input
+ Image of 8-bit, 16-bit or float pixels with any number of channels from which the
+ contrasts are measured, none if empty
+ @param connectivity
+ Neighbourhood of the pixels, 4 or 8
+ @return Region adjacency graph, the regions sorted by label
  */
-/*
-std::vector<std::vector<int> > getLabelsAdjList(const cv::Mat &labels, std::vector<int> &id_labels) {
+caib::regionGraph caib::labelsGraph(const cv::Mat &labels, const cv::Mat &input, const int &connectivity) {
+    
+    CV_Assert (labels.type() == cv::DataType<int>::type && (connectivity == 4 || connectivity == 8));
+    CV_Assert (input.empty() || (input.size() == labels.size() && (input.depth() == CV_8U || input.depth() == CV_16U || input.depth() == CV_32F)));
+    
+    labelTable table = indexLabels(labels);
+    
+    int nstrips = std::max(1, std::min(labels.rows, cv::getNumThreads() * 4));
+    int stripRows = (labels.rows + nstrips - 1) / nstrips;
+    nstrips = labels.rows > 0 ? (labels.rows + stripRows - 1) / stripRows : 0;
+    
+    std::vector<std::vector<edgeSample> > samples(nstrips);
+    std::vector<char> present(table.size, 0);
+    
+    if ( input.depth() == CV_16U )
+        cv::parallel_for_(cv::Range(0, nstrips), labelsGraphBody<ushort>(labels, table, input, connectivity, stripRows, samples, present));
+    else if ( input.depth() == CV_32F )
+        cv::parallel_for_(cv::Range(0, nstrips), labelsGraphBody<float>(labels, table, input, connectivity, stripRows, samples, present));
+    else
+        cv::parallel_for_(cv::Range(0, nstrips), labelsGraphBody<uchar>(labels, table, input, connectivity, stripRows, samples, present));
+    
+    //regions present in the image
+    caib::regionGraph graph;
+    std::vector<int> region(table.size, -1);
+    
+    for ( int i = 0; i < table.size; i++ ) {
+        if ( present[i] ) {
+            region[i] = (int)graph.labels.size();
+            graph.labels.push_back(table.label(i));
+        }
+    }
+    
+    //merge the pairs of the same regions
+    std::vector<edgeSample> edges;
+    for ( int s = 0; s < nstrips; s++ ) {
+        edges.insert(edges.end(), samples[s].begin(), samples[s].end());
+        std::vector<edgeSample>().swap(samples[s]);
+    }
+    
+    std::sort(edges.begin(), edges.end());
+    
+    int nedges = 0;
+    for ( int i = 0; i < edges.size(); i++ ) {
+        if ( nedges > 0 && edges[nedges - 1].a == edges[i].a && edges[nedges - 1].b == edges[i].b ) {
+            edges[nedges - 1].count += edges[i].count;
+            edges[nedges - 1].sum += edges[i].sum;
+            edges[nedges - 1].max = std::max(edges[nedges - 1].max, edges[i].max);
+        } else {
+            edges[nedges++] = edges[i];
+        }
+    }
+    
+    edges.resize(nedges);
+    
+    //compressed sparse rows, every edge is stored in both of its regions; the edges are
+    //sorted, so the neighbours of each region arrive sorted
+    int nregions = (int)graph.labels.size();
+    graph.offsets.assign(nregions + 1, 0);
+    
+    for ( int e = 0; e < nedges; e++ ) {
+        graph.offsets[region[edges[e].a] + 1]++;
+        graph.offsets[region[edges[e].b] + 1]++;
+    }
+    
+    for ( int r = 0; r < nregions; r++ )
+        graph.offsets[r + 1] += graph.offsets[r];
     
-    const int dx8[8] = {-1, -1,  0,  1, 1, 1, 0, -1};
-	const int dy8[8] = { 0, -1, -1, -1, 0, 1, 1,  1};
+    graph.neighbours.resize(2 * nedges);
+    graph.boundary.resize(2 * nedges);
+    graph.contrast.resize(input.empty() ? 0 : 2 * nedges);
+    graph.maxContrast.resize(input.empty() ? 0 : 2 * nedges);
     
-    std::vector<std::vector<int> > labelsAdjList;
+    std::vector<int> fill(graph.offsets.begin(), graph.offsets.end() - 1);
     
-	for( int j = 0; j < labels.rows; j++ )
-	{
-		for( int k = 0; k < labels.cols; k++ )
-		{
+    for ( int e = 0; e < nedges; e++ ) {
+        int ends[2] = { region[edges[e].a], region[edges[e].b] };
+        
+        for ( int k = 0; k < 2; k++ ) {
+            int slot = fill[ends[k]]++;
+            graph.neighbours[slot] = ends[1 - k];
+            graph.boundary[slot] = edges[e].count;
             
-            int mainindex = k + (j * labels.cols);
-            std::vector<int>::iterator it = std::find(id_labels.begin(), id_labels.end(), labels.ptr<int>()[mainindex]);
-            if ( it == id_labels.end()) {
-                id_labels.push_back(labels.ptr<int>()[mainindex]);
-                labelsAdjList.push_back(std::vector<int>());
+            if ( !input.empty() ) {
+                graph.contrast[slot] = (float)(edges[e].sum / edges[e].count);
+                graph.maxContrast[slot] = edges[e].max;
             }
+        }
+    }
+    
+    return graph;
+}
+
+//Sums of the properties of a region over a band of rows
+struct regionSums {
+    int index;                          //label index of the region
+    int area, perimeter;
+    int x0, y0, x1, y1;                 //bounding box, inclusive
+    double sx, sy, sxx, sxy, syy;       //raw moments
+    double sum;                         //sum of the intensities
+    float low, high;                    //smallest and largest intensities
+};
+
+//Add the sums of a region from another band
+inline void mergeSums(regionSums &acc, const regionSums &other) {
+    acc.area += other.area;
+    acc.perimeter += other.perimeter;
+    acc.x0 = std::min(acc.x0, other.x0);
+    acc.y0 = std::min(acc.y0, other.y0);
+    acc.x1 = std::max(acc.x1, other.x1);
+    acc.y1 = std::max(acc.y1, other.y1);
+    acc.sx += other.sx;
+    acc.sy += other.sy;
+    acc.sxx += other.sxx;
+    acc.sxy += other.sxy;
+    acc.syy += other.syy;
+    acc.sum += other.sum;
+    acc.low = std::min(acc.low, other.low);
+    acc.high = std::max(acc.high, other.high);
+}
+
+//Accumulate the properties of the regions on bands of rows, each band with its own sums
+//for the regions it meets
+template <class T>
+class regionPropsBody : public cv::ParallelLoopBody {
+public:
+    regionPropsBody(const cv::Mat &labels, const labelTable &table, const cv::Mat &input, const int &stripRows, std::vector<std::vector<regionSums> > &sums)
+    : labels(labels), table(table), input(input), stripRows(stripRows), sums(&sums) {}
+    
+    void operator()(const cv::Range &range) const {
+        int rows = labels.rows, cols = labels.cols;
+        std::vector<int> slot(table.size);
+        
+        for ( int s = range.start; s < range.end; s++ ) {
+            std::vector<regionSums> &acc = (*sums)[s];
+            std::fill(slot.begin(), slot.end(), -1);
             
-			for( int i = 0; i < 8; i++ )
-			{
-				int x = k + dx8[i];
-				int y = j + dy8[i];
+            for ( int y = s * stripRows; y < std::min(rows, (s + 1) * stripRows); y++ ) {
+                const int *lab = labels.ptr<int>(y);
+                const int *above = y > 0 ? labels.ptr<int>(y - 1) : 0;
+                const int *below = y + 1 < rows ? labels.ptr<int>(y + 1) : 0;
+                const T *in = input.empty() ? 0 : input.ptr<T>(y);
+                
+                //the labels come in runs, the last one found is kept
+                int last = lab[0], i = table.index(last);
                 
-				if( (x >= 0 && x < labels.cols) && (y >= 0 && y < labels.rows) )
-				{
-					int index = y*labels.cols + x;
+                for ( int x = 0; x < cols; x++ ) {
+                    if ( lab[x] != last ) {
+                        last = lab[x];
+                        i = table.index(last);
+                    }
                     
-                    if( labels.ptr<int>()[mainindex] != labels.ptr<int>()[index] ) {
-                        if(it != id_labels.end()){
-                            if(std::find(labelsAdjList[id_labels.begin() - it].begin(), labelsAdjList[id_labels.begin() - it].end(), labels.ptr<int>()[mainindex]) ==labelsAdjList[id_labels.begin() - it].end()) {
-                                labelsAdjList[id_labels.begin() - it].push_back(labels.ptr<int>()[mainindex]);
-                            }
-                        } else {
-                            labelsAdjList[id_labels.size() -1].push_back(labels.ptr<int>()[mainindex]);
-                        }
+                    if ( slot[i] < 0 ) {
+                        regionSums r;
+                        r.index = i;
+                        r.area = r.perimeter = 0;
+                        r.x0 = r.x1 = x;
+                        r.y0 = r.y1 = y;
+                        r.sx = r.sy = r.sxx = r.sxy = r.syy = r.sum = 0;
+                        r.low = in ? (float)in[x] : 0;
+                        r.high = r.low;
+                        
+                        slot[i] = (int)acc.size();
+                        acc.push_back(r);
                     }
-				}
-			}
-           
+                    
+                    regionSums &r = acc[slot[i]];
+                    r.area++;
+                    r.x0 = std::min(r.x0, x);
+                    r.x1 = std::max(r.x1, x);
+                    r.y1 = y;
+                    r.sx += x;
+                    r.sy += y;
+                    r.sxx += (double)x * x;
+                    r.sxy += (double)x * y;
+                    r.syy += (double)y * y;
+                    
+                    //sides of the pixel on the frame or on another region
+                    r.perimeter += (x == 0 || lab[x - 1] != last) + (x == cols - 1 || lab[x + 1] != last) + (!above || above[x] != last) + (!below || below[x] != last);
+                    
+                    if ( in ) {
+                        float v = (float)in[x];
+                        r.sum += v;
+                        r.low = std::min(r.low, v);
+                        r.high = std::max(r.high, v);
+                    }
+                }
+            }
+        }
+    }
+    
+private:
+    const cv::Mat &labels;
+    const labelTable &table;
+    const cv::Mat &input;
+    int stripRows;
+    std::vector<std::vector<regionSums> > *sums;
+};
+
+/**
+ Measure the regions of a labeled image in one scan: area, bounding box, centroid,
+ second order central moments, perimeter and, given an intensity image, the mean,
+ smallest and largest intensity of each region
+ @param labels
+ Labeled image
+ @param input
+ Single channel image of 8-bit, 16-bit or float pixels, none if empty
+ @return Table of the properties, the regions sorted by label
+ */
+caib::regionTable caib::regionProps(const cv::Mat &labels, const cv::Mat &input) {
+    
+    CV_Assert (labels.type() == cv::DataType<int>::type);
+    CV_Assert (input.empty() || (caib::isIntensity(input) && input.size() == labels.size()));
+    
+    labelTable table = indexLabels(labels);
+    
+    int nstrips = std::max(1, std::min(labels.rows, cv::getNumThreads() * 4));
+    int stripRows = (labels.rows + nstrips - 1) / nstrips;
+    nstrips = labels.rows > 0 ? (labels.rows + stripRows - 1) / stripRows : 0;
+    
+    std::vector<std::vector<regionSums> > sums(nstrips);
+    
+    if ( input.depth() == CV_16U )
+        cv::parallel_for_(cv::Range(0, nstrips), regionPropsBody<ushort>(labels, table, input, stripRows, sums));
+    else if ( input.depth() == CV_32F )
+        cv::parallel_for_(cv::Range(0, nstrips), regionPropsBody<float>(labels, table, input, stripRows, sums));
+    else
+        cv::parallel_for_(cv::Range(0, nstrips), regionPropsBody<uchar>(labels, table, input, stripRows, sums));
+    
+    //merge the sums of the bands
+    std::vector<int> position(table.size, -1);
+    std::vector<regionSums> regions;
+    
+    for ( int s = 0; s < nstrips; s++ ) {
+        for ( int k = 0; k < sums[s].size(); k++ ) {
+            int &p = position[sums[s][k].index];
             
-		}
-	}
+            if ( p < 0 ) {
+                p = (int)regions.size();
+                regions.push_back(sums[s][k]);
+            } else {
+                mergeSums(regions[p], sums[s][k]);
+            }
+        }
+    }
     
-    return labelsAdjList;
+    std::vector<regionSums> sorted;
+    sorted.reserve(regions.size());
+    for ( int i = 0; i < table.size; i++ ) {
+        if ( position[i] >= 0 )
+            sorted.push_back(regions[position[i]]);
+    }
     
-}*/
-
-
-
-
+    caib::regionTable props;
+    int n = (int)sorted.size();
+    
+    props.labels.resize(n);
+    props.area.resize(n);
+    props.bbox.resize(n);
+    props.centroid.resize(n);
+    props.mu20.resize(n);
+    props.mu11.resize(n);
+    props.mu02.resize(n);
+    props.perimeter.resize(n);
+    
+    if ( !input.empty() ) {
+        props.meanIntensity.resize(n);
+        props.minIntensity.resize(n);
+        props.maxIntensity.resize(n);
+    }
+    
+    for ( int i = 0; i < n; i++ ) {
+        const regionSums &r = sorted[i];
+        double cx = r.sx / r.area, cy = r.sy / r.area;
+        
+        props.labels[i] = table.label(r.index);
+        props.area[i] = r.area;
+        props.bbox[i] = cv::Rect(r.x0, r.y0, r.x1 - r.x0 + 1, r.y1 - r.y0 + 1);
+        props.centroid[i] = cv::Point2f((float)cx, (float)cy);
+        props.mu20[i] = r.sxx - cx * r.sx;
+        props.mu11[i] = r.sxy - cx * r.sy;
+        props.mu02[i] = r.syy - cy * r.sy;
+        props.perimeter[i] = r.perimeter;
+        
+        if ( !input.empty() ) {
+            props.meanIntensity[i] = (float)(r.sum / r.area);
+            props.minIntensity[i] = r.low;
+            props.maxIntensity[i] = r.high;
+        }
+    }
+    
+    return props;
+}
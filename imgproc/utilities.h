@@ -74,21 +74,74 @@ namespace caib {
         std::vector<float> v_bin;
     };
     CAIB_EXPORTS histogram calcHistogram(const cv::Mat &input, int nbins, bool uniform = true, bool accumulate = false );
+    CAIB_EXPORTS std::vector<cv::MatND> calcLabelHist(const cv::Mat &input, const cv::Mat &labels, const std::vector<int> &channels, const std::vector<int> &histSize, const float *ranges[], bool uniform = true);
+    CAIB_EXPORTS std::vector<cv::MatND> calcLabelHist(const cv::Mat &input, const cv::Mat &labels, std::vector<int> &id_labels, const std::vector<int> &channels, const std::vector<int> &histSize, const float *ranges[], bool uniform = true);
+    CAIB_EXPORTS cv::MatND calcLabelHist(const cv::Mat &input, const cv::Mat &labels, const int &label, const std::vector<int> &channels, const std::vector<int> &histSize, const float *ranges[], bool uniform = true);
     
     //Relations
+    const int BINARY_BLOCK = 256;    //bytes checked by isBinary between two early exits
     CAIB_EXPORTS bool isBinary(const cv::Mat &input);
     CAIB_EXPORTS bool isGray(const cv::Mat &input);
+    CAIB_EXPORTS bool isIntensity(const cv::Mat &input);
     CAIB_EXPORTS bool isEqual(const cv::Mat &input1, const cv::Mat &input2);
     CAIB_EXPORTS bool isInside(const cv::Mat &input, const cv::Point &pt);
     
+    //Binary image checked once, the functions taking it skip their isBinary scan. The data
+    //is shared with the wrapped image, which must not be written with other values
+    class CAIB_EXPORTS BinaryMat {
+    public:
+        BinaryMat() {}
+        explicit BinaryMat(const cv::Mat &input);
+        
+        static BinaryMat threshold(const cv::Mat &input, const double &thresh = 0);
+        
+        const cv::Mat &mat() const { return image; }
+        operator const cv::Mat &() const { return image; }
+        
+        bool empty() const { return image.empty(); }
+        cv::Size size() const { return image.size(); }
+        
+    private:
+        cv::Mat image;
+    };
+    
     //Labeled Image Handling
+    struct pixelRun {
+        int y, x, length;   //pixels from (x, y) to (x + length - 1, y)
+    };
+    CAIB_EXPORTS cv::Mat labelsBoundary(const cv::Mat &labels);
+    CAIB_EXPORTS std::vector<pixelRun> labelsBoundaryRuns(const cv::Mat &labels);
     CAIB_EXPORTS cv::Mat drawLabelsContours(const cv::Mat &input, const cv::Mat &labels, const cv::Scalar &color);
     CAIB_EXPORTS cv::Mat paintLabels(const cv::Mat &labels);
+    CAIB_EXPORTS cv::Mat paintLabels(const cv::Mat &input, const cv::Mat &labels, const double &alpha = 0.5);
     CAIB_EXPORTS cv::Mat paintLabel(const cv::Mat &labels, const int &label, const cv::Scalar &color);
+    CAIB_EXPORTS cv::Mat paintLabel(const cv::Mat &input, const cv::Mat &labels, const int &label, const cv::Scalar &color, const double &alpha = 0.5);
     
-    //Deprecated
-    //CAIB_EXPORTS std::vector<cv::MatND> calcLabelHist(const cv::Mat &input, cv::Mat labels, const std::vector<int> &channels, const std::vector<int> &histSize, const float *ranges[], bool uniform = true, bool accumulate = false);
-    //CAIB_EXPORTS cv::MatND calcLabelHist(const cv::Mat &input, cv::Mat labels, const int &label, const std::vector<int> &channels, const std::vector<int> &histSize, const float *ranges[], bool uniform = true, bool accumulate = false);
+    //Region adjacency graph in compressed sparse rows: the edges of the region i are the
+    //entries offsets[i] to offsets[i + 1] - 1 of the edge arrays, sorted by neighbour
+    struct regionGraph {
+        std::vector<int> labels;            //label of each region, sorted
+        std::vector<int> offsets;           //first edge of each region, the number of entries at the end
+        std::vector<int> neighbours;        //region at the other end of each edge
+        std::vector<int> boundary;          //pixel pairs shared along each edge
+        std::vector<float> contrast;        //mean intensity difference along each edge
+        std::vector<float> maxContrast;     //largest intensity difference along each edge
+    };
+    CAIB_EXPORTS regionGraph labelsGraph(const cv::Mat &labels, const cv::Mat &input = cv::Mat(), const int &connectivity = 8);
+    
+    //Properties of the regions of a labeled image, stored as one array per property
+    struct regionTable {
+        std::vector<int> labels;                //label of each region, sorted
+        std::vector<int> area;                  //number of pixels
+        std::vector<cv::Rect> bbox;             //bounding box
+        std::vector<cv::Point2f> centroid;      //mean position of the pixels
+        std::vector<double> mu20, mu11, mu02;   //second order central moments
+        std::vector<int> perimeter;             //pixel sides on the frame or on another region
+        std::vector<float> meanIntensity;       //intensities, empty without intensity image
+        std::vector<float> minIntensity;
+        std::vector<float> maxIntensity;
+    };
+    CAIB_EXPORTS regionTable regionProps(const cv::Mat &labels, const cv::Mat &input = cv::Mat());
     
 };
 